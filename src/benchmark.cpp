@@ -0,0 +1,118 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2021 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <fstream>
+#include <iostream>
+#include <istream>
+#include <vector>
+
+#include "types.h"
+
+using namespace std;
+
+namespace {
+
+const vector<string> Defaults = {
+  "rnbakabnr/9/1c5c1/p1p1p1p1p/9/9/P1P1P1P1P/1C5C1/9/RNBAKABNR w - - 0 1",
+  "rnbakabnr/9/1c5c1/p1p1p1p1p/9/9/P1P1P1P1P/1C2C4/9/RNBAKABNR b - - 1 1",
+  "r1bakabr1/9/1cn3nc1/p1p1p1p1p/9/9/P1P1P1P1P/1CN3NC1/9/R1BAKABR1 w - - 4 3",
+  "r1ba1a3/4kn3/2n1b4/pNp1p1p1p/4c4/6P2/P1P2R2P/1CcC5/9/2BAKAB2 w - - 0 1",
+  "1cbak4/9/n2a5/2p1p3p/5cp2/2n2N3/6PCP/3AB4/2C6/3A1K1N1 w - - 0 1",
+  "2bak4/9/3a5/p2Np3p/3n1P3/3pc3P/P4r3/2N1B4/4A4/3AK1B2 w - - 0 1",
+  "3ak4/4a4/4b4/4p4/2b6/9/4P4/4B4/4A4/4KA3 w - - 0 1",
+  "5a3/3k5/3aR4/9/5r3/5n3/9/3A1A3/5K3/2BC2B2 w - - 0 1"
+};
+
+} // namespace
+
+namespace Stockfish {
+
+/// setup_bench() builds a list of UCI commands to be run by bench. There
+/// are six parameters: TT size in MB, number of search threads that
+/// should be used, the limit value spent for each position, a file name
+/// where to look for positions in FEN format, the type of the limit:
+/// depth, perft, nodes and movetime (in millisecs), and 'smp' to run the
+/// positions once with each value of the "SMP Mode" option.
+///
+/// bench -> search default positions up to depth 4
+/// bench 64 1 5 -> search default positions up to depth 5 (TT = 64MB)
+/// bench 64 1 5000 fens.txt movetime -> search positions in fens.txt for 5 sec each
+/// bench 64 1 100000 default nodes -> search default positions for 100K nodes each
+/// bench 16 1 4 default perft -> run a perft 4 on default positions
+/// bench 256 8 16 default depth smp -> compare the time to depth 16 of the SMP modes
+
+vector<string> setup_bench(istream& is) {
+
+  vector<string> fens, list;
+  string go, token;
+
+  // Assign default values to missing arguments
+  string ttSize    = (is >> token) ? token : "16";
+  string threads   = (is >> token) ? token : "1";
+  string limit     = (is >> token) ? token : "4";
+  string fenFile   = (is >> token) ? token : "default";
+  string limitType = (is >> token) ? token : "depth";
+  bool smpModes    = (is >> token) && token == "smp";
+
+  go = limitType == "eval" ? "eval" : "go " + limitType + " " + limit;
+
+  if (fenFile == "default")
+      fens = Defaults;
+
+  else
+  {
+      string fen;
+      ifstream file(fenFile);
+
+      if (!file.is_open())
+      {
+          cerr << "Unable to open file " << fenFile << endl;
+          exit(EXIT_FAILURE);
+      }
+
+      while (getline(file, fen))
+          if (!fen.empty())
+              fens.push_back(fen);
+
+      file.close();
+  }
+
+  list.emplace_back("setoption name Threads value " + threads);
+  list.emplace_back("setoption name Hash value " + ttSize);
+
+  for (string mode : smpModes ? vector<string>{ "Lazy", "ABDADA" } : vector<string>{ "" })
+  {
+      if (!mode.empty())
+          list.emplace_back("setoption name SMP Mode value " + mode);
+
+      list.emplace_back("ucinewgame");
+
+      for (const string& fen : fens)
+          if (fen.find("setoption") != string::npos)
+              list.emplace_back(fen);
+          else
+          {
+              list.emplace_back("position fen " + fen);
+              list.emplace_back(go);
+          }
+  }
+
+  return list;
+}
+
+} // namespace Stockfish
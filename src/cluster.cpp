@@ -0,0 +1,596 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2021 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "cluster.h"
+#include "misc.h"
+#include "thread.h"
+#include "uci.h"
+
+namespace Stockfish {
+
+namespace {
+
+  // Best line reported by a worker for one depth
+  struct Report {
+    Value score = VALUE_NONE;
+    std::vector<std::string> pv;
+  };
+
+  // A connected worker. Its lines are read by a thread of its own, all the
+  // fields below 'mutex' are protected by it.
+  struct Worker {
+    std::string address;
+    int fd;
+    std::thread reader;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<Report> reports; // [depth - 1], for the current search
+    uint64_t nodes = 0;
+    Value rawScore = VALUE_NONE; // Sent just before the info line it belongs to
+    bool connected = true, ready = false, used = false, searching = false;
+  };
+
+  std::vector<std::unique_ptr<Worker>> workers;
+  std::string positionCmd = "position startpos";
+  bool isWorker;
+
+#if !defined(_WIN32)
+
+  // open_socket() connects to the given address or, with 'server' set,
+  // listens on it. An address with a '/' is a Unix-domain socket, otherwise
+  // it is a TCP port, "port" for the loopback interface or "host:port".
+  // Returns the socket, or -1 on failure.
+
+  int open_socket(const std::string& address, bool server) {
+
+    int fd;
+    bool ok;
+
+    if (address.find('/') != std::string::npos)
+    {
+        sockaddr_un sa = {};
+        sa.sun_family = AF_UNIX;
+        std::strncpy(sa.sun_path, address.c_str(), sizeof(sa.sun_path) - 1);
+
+        if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+            return -1;
+
+        if (server)
+            unlink(sa.sun_path);
+
+        ok = server ? !bind(fd, (sockaddr*)&sa, sizeof(sa)) && !listen(fd, 1)
+                    : !::connect(fd, (sockaddr*)&sa, sizeof(sa));
+    }
+    else
+    {
+        size_t colon = address.rfind(':');
+        std::string host = colon == std::string::npos ? "127.0.0.1" : address.substr(0, colon);
+        sockaddr_in sa = {};
+        int one = 1;
+
+        sa.sin_family = AF_INET;
+        sa.sin_port = htons(uint16_t(std::atoi(address.c_str() + (colon == std::string::npos ? 0 : colon + 1))));
+
+        if (   inet_pton(AF_INET, host.c_str(), &sa.sin_addr) != 1
+            || (fd = socket(AF_INET, SOCK_STREAM, 0)) < 0)
+            return -1;
+
+        // Lines are short and answered at once, do not let them wait
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        if (server)
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+        ok = server ? !bind(fd, (sockaddr*)&sa, sizeof(sa)) && !listen(fd, 1)
+                    : !::connect(fd, (sockaddr*)&sa, sizeof(sa));
+    }
+
+    if (!ok)
+    {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+  }
+
+
+  void write_line(Worker& w, const std::string& cmd) {
+
+    std::string line = cmd + "\n";
+    ::send(w.fd, line.data(), line.size(), MSG_NOSIGNAL);
+  }
+
+#else
+
+  // Only POSIX sockets are supported, elsewhere there are never any workers
+  void write_line(Worker&, const std::string&) {}
+
+#endif
+
+
+  // parse() reads a line sent by a worker. Only the lines of the best move
+  // with an exact score are kept, they are printed once per depth. The score
+  // is the internal value sent by the worker in an 'info string cluster score'
+  // line, as the centipawns of the info line are rounded and could not be
+  // compared with our own scores.
+
+  void parse(Worker& w, const std::string& line) {
+
+    std::istringstream is(line);
+    std::string token;
+
+    is >> token;
+
+    std::lock_guard<std::mutex> lk(w.mutex);
+
+    if (token == "readyok")
+        w.ready = true;
+
+    else if (token == "bestmove")
+        w.searching = false;
+
+    else if (token == "info")
+    {
+        Report r;
+        Depth depth = 0;
+        int multiPV = 1, v;
+        bool bound = false;
+
+        if (is >> token && token == "string")
+        {
+            if (is >> token && token == "cluster" && is >> token >> v && token == "score")
+                w.rawScore = Value(v);
+
+            w.cv.notify_all();
+            return;
+        }
+
+        r.score = w.rawScore;
+        w.rawScore = VALUE_NONE;
+
+        do
+            if (token == "depth")
+                is >> depth;
+
+            else if (token == "multipv")
+                is >> multiPV;
+
+            else if (token == "nodes")
+                is >> w.nodes;
+
+            else if (token == "lowerbound" || token == "upperbound")
+                bound = true;
+
+            else if (token == "pv")
+                while (is >> token)
+                    r.pv.push_back(token);
+
+        while (is >> token);
+
+        if (depth > 0 && multiPV == 1 && !bound && r.score != VALUE_NONE && !r.pv.empty())
+        {
+            if (int(w.reports.size()) < depth)
+                w.reports.resize(depth);
+
+            w.reports[depth - 1] = r;
+        }
+    }
+
+    w.cv.notify_all();
+  }
+
+
+#if !defined(_WIN32)
+
+  void read_loop(Worker* w) {
+
+    std::string buf;
+    char chunk[4096];
+    ssize_t n;
+
+    while ((n = recv(w->fd, chunk, sizeof(chunk), 0)) > 0)
+    {
+        buf.append(chunk, size_t(n));
+
+        for (size_t eol; (eol = buf.find('\n')) != std::string::npos; buf.erase(0, eol + 1))
+            parse(*w, buf.substr(0, eol));
+    }
+
+    // The worker is gone, it takes no further part in the searches
+    std::lock_guard<std::mutex> lk(w->mutex);
+    w->connected = w->ready = w->searching = false;
+    w->cv.notify_all();
+  }
+
+
+  void disconnect() {
+
+    for (auto& w : workers)
+    {
+        shutdown(w->fd, SHUT_RDWR);
+        w->reader.join();
+        close(w->fd);
+    }
+
+    workers.clear();
+  }
+
+#endif
+
+} // namespace
+
+
+#if !defined(_WIN32)
+
+
+/// Cluster::connect() is called when the "Cluster Workers" option changes. It
+/// drops the current workers, if any, and connects to the comma separated
+/// list of addresses. An empty list ends the cluster mode.
+
+void Cluster::connect(const std::string& addresses) {
+
+  Threads.main()->wait_for_search_finished();
+
+  disconnect();
+
+  std::istringstream is(addresses);
+  std::string address;
+
+  while (std::getline(is, address, ','))
+  {
+      address.erase(std::remove(address.begin(), address.end(), ' '), address.end());
+
+      if (address.empty() || address == "<empty>")
+          continue;
+
+      int fd = open_socket(address, false);
+
+      if (fd < 0)
+      {
+          sync_cout << "info string Unable to connect to cluster worker " << address << sync_endl;
+          continue;
+      }
+
+      auto w = std::make_unique<Worker>();
+      w->address = address;
+      w->fd = fd;
+      w->reader = std::thread(read_loop, w.get());
+
+      write_line(*w, "isready");
+
+      // A worker still busy or hung must not block the option forever
+      std::unique_lock<std::mutex> lk(w->mutex);
+      bool answered = w->cv.wait_for(lk, std::chrono::seconds(10),
+                                     [&]{ return w->ready || !w->connected; });
+      lk.unlock();
+
+      if (!answered)
+      {
+          shutdown(w->fd, SHUT_RDWR);
+          w->reader.join();
+          close(w->fd);
+
+          sync_cout << "info string No answer from cluster worker " << address << sync_endl;
+          continue;
+      }
+
+      workers.push_back(std::move(w));
+
+      sync_cout << "info string " << (workers.back()->ready ? "Connected to" : "Lost")
+                << " cluster worker " << address << sync_endl;
+  }
+}
+
+
+/// Cluster::serve() is called by the 'worker <address>' command. It waits for
+/// a coordinator on the address, after which the standard input and output
+/// of the engine are those of the connection.
+
+void Cluster::serve(std::istream& is) {
+
+  std::string address;
+  is >> address;
+
+  int server = open_socket(address, true);
+
+  if (server < 0)
+  {
+      sync_cout << "info string Unable to listen on " << address << sync_endl;
+      return;
+  }
+
+  sync_cout << "info string Waiting for the coordinator on " << address << sync_endl;
+
+  int fd = accept(server, nullptr, nullptr);
+  close(server);
+
+  if (address.find('/') != std::string::npos)
+      unlink(address.c_str());
+
+  if (fd < 0)
+      return;
+
+  std::signal(SIGPIPE, SIG_IGN); // A lost coordinator must not kill us mid-line
+  dup2(fd, STDIN_FILENO);
+  dup2(fd, STDOUT_FILENO);
+  close(fd);
+
+  isWorker = true;
+}
+
+#else
+
+void Cluster::connect(const std::string& addresses) {
+
+  if (!addresses.empty() && addresses != "<empty>")
+      sync_cout << "info string Cluster mode is not available on this platform" << sync_endl;
+}
+
+void Cluster::serve(std::istream&) {
+  sync_cout << "info string Cluster mode is not available on this platform" << sync_endl;
+}
+
+#endif
+
+
+/// Cluster::serving() tells whether we are the worker of a coordinator, which
+/// then needs our scores with full precision, see UCI::pv().
+
+bool Cluster::serving() {
+  return isWorker;
+}
+
+
+/// Cluster::send() forwards a UCI command to all the workers, except the
+/// setting of the "Cluster Workers" option itself.
+
+void Cluster::send(const std::string& cmd) {
+
+  if (cmd.find("Cluster Workers") != std::string::npos)
+      return;
+
+  for (auto& w : workers)
+      write_line(*w, cmd);
+}
+
+
+/// Cluster::set_position() keeps the last 'position' command, sent again to
+/// the workers at every search.
+
+void Cluster::set_position(const std::string& cmd) {
+  positionCmd = cmd;
+}
+
+
+/// Cluster::start() deals out the root moves between the coordinator, which
+/// keeps its share in 'rootMoves', and the connected workers, and starts the
+/// workers. They get the same depth limit and a share of the node limit, the
+/// coordinator keeping its own in 'limits'. The clock is kept by the
+/// coordinator, which stops them. Mate searches and perft stay local.
+
+void Cluster::start(Search::LimitsType& limits, Search::RootMoves& rootMoves) {
+
+  std::vector<Worker*> live;
+
+  for (auto& w : workers)
+  {
+      std::lock_guard<std::mutex> lk(w->mutex);
+      w->used = false;
+      w->nodes = 0;
+      w->reports.clear();
+
+      if (w->connected)
+          live.push_back(w.get());
+  }
+
+  if (live.empty() || rootMoves.empty() || limits.mate || limits.perft)
+      return;
+
+  size_t parts = std::min(live.size() + 1, rootMoves.size());
+  std::vector<std::string> searchMoves(parts);
+  Search::RootMoves ours;
+
+  for (size_t i = 0; i < rootMoves.size(); ++i)
+      if (i % parts == 0)
+          ours.push_back(rootMoves[i]);
+      else
+          searchMoves[i % parts] += " " + UCI::move(rootMoves[i].pv[0]);
+
+  std::string go = "go";
+
+  if (limits.depth)
+      go += " depth " + std::to_string(limits.depth);
+
+  if (!limits.depth && !limits.nodes)
+      go += " infinite";
+
+  // Split the node limit, the coordinator being part 0
+  int64_t nodes = limits.nodes;
+  auto share = [&](size_t i) { return std::max(nodes / int64_t(parts) + (int64_t(i) < nodes % int64_t(parts)), int64_t(1)); };
+
+  for (size_t i = 1; i < parts; ++i)
+  {
+      Worker& w = *live[i - 1];
+      {
+          std::lock_guard<std::mutex> lk(w.mutex);
+          w.used = w.searching = true;
+      }
+      write_line(w, positionCmd);
+      write_line(w, go + (nodes ? " nodes " + std::to_string(share(i)) : "")
+                       + " searchmoves" + searchMoves[i]);
+  }
+
+  if (nodes)
+      limits.nodes = share(0);
+
+  rootMoves = ours;
+}
+
+
+/// Cluster::stop() stops the workers still searching
+
+void Cluster::stop() {
+
+  for (auto& w : workers)
+  {
+      std::lock_guard<std::mutex> lk(w->mutex);
+
+      if (w->searching)
+          write_line(*w, "stop");
+  }
+}
+
+
+/// Cluster::finish() waits for the "bestmove" of all the workers of the
+/// search, stopping them first with 'stopWorkers' set.
+
+void Cluster::finish(bool stopWorkers) {
+
+  if (stopWorkers)
+      stop();
+
+  for (auto& w : workers)
+  {
+      std::unique_lock<std::mutex> lk(w->mutex);
+      w->cv.wait(lk, [&]{ return !w->searching; });
+  }
+}
+
+
+/// Cluster::active() tells whether the workers take part in the current search
+
+bool Cluster::active() {
+
+  for (auto& w : workers)
+  {
+      std::lock_guard<std::mutex> lk(w->mutex);
+
+      if (w->used)
+          return true;
+  }
+
+  return false;
+}
+
+
+/// Cluster::depth() returns the highest depth reported by all the workers of
+/// the search.
+
+Depth Cluster::depth() {
+
+  Depth d = MAX_PLY;
+
+  for (auto& w : workers)
+  {
+      std::lock_guard<std::mutex> lk(w->mutex);
+
+      if (w->used)
+          d = std::min(d, Depth(w->reports.size()));
+  }
+
+  return d;
+}
+
+
+/// Cluster::nodes_searched() returns the nodes reported by the workers of the
+/// search, to be added to ours.
+
+uint64_t Cluster::nodes_searched() {
+
+  uint64_t nodes = 0;
+
+  for (auto& w : workers)
+  {
+      std::lock_guard<std::mutex> lk(w->mutex);
+
+      if (w->used)
+          nodes += w->nodes;
+  }
+
+  return nodes;
+}
+
+
+/// Cluster::results() appends to 'out' the best line of every worker at the
+/// given depth, or the deepest one it reported if it did not report that
+/// depth. The lines are replayed from the root position to get the moves.
+
+void Cluster::results(const Position& pos, Depth depth, Search::RootMoves& out) {
+
+  for (auto& w : workers)
+  {
+      std::lock_guard<std::mutex> lk(w->mutex);
+
+      if (!w->used || w->reports.empty())
+          continue;
+
+      const Report& r =  depth > 0 && depth <= int(w->reports.size())
+                      && w->reports[depth - 1].score != VALUE_NONE ? w->reports[depth - 1]
+                                                                   : w->reports.back();
+
+      std::vector<StateInfo> st(r.pv.size() + 1);
+      Position p;
+      p.set(pos, &st[0], pos.this_thread());
+
+      Search::RootMove rm(MOVE_NONE);
+      rm.pv.clear();
+
+      for (size_t i = 0; i < r.pv.size(); ++i)
+      {
+          std::string token = r.pv[i];
+          Move m = UCI::to_move(p, token);
+
+          if (m == MOVE_NONE || !p.do_move(m, st[i + 1]))
+              break;
+
+          rm.pv.push_back(m);
+      }
+
+      if (rm.pv.empty())
+          continue;
+
+      rm.score = r.score;
+      rm.selDepth = depth;
+      out.push_back(rm);
+  }
+}
+
+} // namespace Stockfish
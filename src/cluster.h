@@ -0,0 +1,62 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2021 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CLUSTER_H_INCLUDED
+#define CLUSTER_H_INCLUDED
+
+#include <istream>
+#include <string>
+
+#include "position.h"
+#include "search.h"
+#include "types.h"
+
+namespace Stockfish {
+
+/// Cluster spreads a search over several engine processes. A worker is an
+/// ordinary engine started with 'worker <address>', where the address is the
+/// path of a Unix-domain socket or a TCP port, "port" or "host:port". It waits
+/// for the coordinator and then talks plain UCI over the connection. The
+/// coordinator connects to the workers listed in the "Cluster Workers" option
+/// and forwards them the position, ucinewgame and setoption commands. At every
+/// 'go' the root moves are dealt out between the coordinator and the workers,
+/// which get theirs as 'searchmoves'. The coordinator keeps the clock, reads
+/// the lines the workers report and merges them into its own info and
+/// bestmove output, so that the GUI sees a single engine.
+
+namespace Cluster {
+
+void connect(const std::string& addresses);
+void serve(std::istream& is);
+void send(const std::string& cmd);
+void set_position(const std::string& cmd);
+
+void start(Search::LimitsType& limits, Search::RootMoves& rootMoves);
+void stop();
+void finish(bool stopWorkers);
+bool active();
+bool serving();
+Depth depth();
+uint64_t nodes_searched();
+void results(const Position& pos, Depth depth, Search::RootMoves& out);
+
+} // namespace Cluster
+
+} // namespace Stockfish
+
+#endif // #ifndef CLUSTER_H_INCLUDED
@@ -0,0 +1,292 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2021 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cstring>   // For std::memset
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "dfpn.h"
+#include "misc.h"
+#include "movegen.h"
+#include "position.h"
+#include "uci.h"
+
+namespace Stockfish {
+
+namespace {
+
+  // Proof and disproof numbers of a proven or disproven node. Sums saturate
+  // there, so that they cannot overflow.
+  constexpr uint32_t Infinite = 1u << 30;
+
+  // Longest path explored, deeper nodes count as disproven
+  constexpr int MaxPly = MAX_PLY - 1;
+
+  // The proof and disproof numbers of a position, from the attacker's
+  // point of view whichever side is to move.
+  struct Entry {
+    Key key;
+    uint32_t pn, dn;
+  };
+
+  struct Child {
+    Move move;
+    Key key;
+    bool loss; // Repetition or too deep: a disproof, not stored
+  };
+
+  Entry* table;
+  size_t mask;
+  uint64_t nodes, nodesLimit;
+  bool aborted;
+
+  uint32_t add(uint32_t a, uint32_t b) {
+    return uint32_t(std::min(uint64_t(a) + b, uint64_t(Infinite)));
+  }
+
+  // Entries are always replaced: the solver only needs the numbers of the
+  // nodes it works on to be kept, to make progress.
+  void store(Key key, uint32_t pn, uint32_t dn) {
+    table[key & mask] = Entry{ key, pn, dn };
+  }
+
+  void lookup(Key key, uint32_t& pn, uint32_t& dn) {
+    const Entry& e = table[key & mask];
+    if (e.key == key)
+        pn = e.pn, dn = e.dn;
+    else
+        pn = dn = 1;
+  }
+
+
+  // mid() is the multiple iterative deepening step of df-pn: it expands the
+  // node until its proof number reaches thpn or its disproof number reaches
+  // thdn, always descending into the most proving child. The numbers are
+  // handled as phi and delta, which are the proof and disproof numbers at
+  // attacker nodes and the other way round at defender nodes, so that both
+  // node types share the same code.
+
+  void mid(Position& pos, uint32_t thpn, uint32_t thdn, bool orNode, int ply) {
+
+    Child children[MAX_MOVES];
+    StateInfo st;
+    int count = 0;
+    Key key = pos.hash_key();
+
+    if (++nodes >= nodesLimit)
+        aborted = true;
+
+    for (const auto& m : MoveList<PSEUDO_LEGAL>(pos))
+        if (pos.do_move(m, st))
+        {
+            if (!orNode || pos.in_check())
+                children[count++] = { m, pos.hash_key(), pos.is_repetition() || ply + 1 >= MaxPly };
+
+            pos.undo_move(m);
+        }
+
+    // The attacker without a check is disproven, the defender without a
+    // legal move is mated (or stalemated, a loss too).
+    if (!count)
+    {
+        orNode ? store(key, Infinite, 0) : store(key, 0, Infinite);
+        return;
+    }
+
+    uint32_t thphi   = orNode ? thpn : thdn;
+    uint32_t thdelta = orNode ? thdn : thpn;
+
+    while (true)
+    {
+        uint32_t phi = Infinite, delta = 0, phi2 = Infinite, bestDelta = 0;
+        int best = 0;
+
+        for (int i = 0; i < count; ++i)
+        {
+            uint32_t pn = Infinite, dn = 0;
+
+            // Perpetual check loses in xiangqi, and a defender repeating the
+            // position only shows the checks go nowhere: both are disproofs.
+            if (!children[i].loss)
+                lookup(children[i].key, pn, dn);
+
+            uint32_t cphi   = orNode ? pn : dn;
+            uint32_t cdelta = orNode ? dn : pn;
+
+            delta = add(delta, cdelta);
+
+            if (cphi < phi)
+            {
+                phi2 = phi;
+                phi = cphi;
+                best = i;
+                bestDelta = cdelta;
+            }
+            else if (cphi < phi2)
+                phi2 = cphi;
+        }
+
+        if (phi >= thphi || delta >= thdelta || aborted)
+        {
+            orNode ? store(key, phi, delta) : store(key, delta, phi);
+            return;
+        }
+
+        // Thresholds of the best child, in this node's terms. The bound from
+        // the second best child is loosened by a quarter (the 1 + epsilon
+        // trick) to avoid switching back and forth between two children.
+        uint32_t thChildPhi   = uint32_t(std::min(uint64_t(thphi), phi2 + uint64_t(phi2) / 4 + 1));
+        uint32_t thChildDelta = add(thdelta - delta, bestDelta);
+
+        pos.do_move(children[best].move, st);
+
+        orNode ? mid(pos, thChildPhi, thChildDelta, false, ply + 1)
+               : mid(pos, thChildDelta, thChildPhi, true, ply + 1);
+
+        pos.undo_move(children[best].move);
+    }
+  }
+
+
+  // proof_pv() follows a proof from the root: at attacker nodes a proven
+  // child, at defender nodes the first reply still proven. It stops where
+  // the table lost an entry, so the line may end before the mate.
+
+  std::vector<Move> proof_pv(Position& pos) {
+
+    std::vector<Move> pv;
+    std::vector<StateInfo> states(MaxPly);
+    bool orNode = true;
+
+    while (int(pv.size()) < MaxPly)
+    {
+        Move next = MOVE_NONE;
+        StateInfo st;
+
+        for (const auto& m : MoveList<PSEUDO_LEGAL>(pos))
+            if (pos.do_move(m, st))
+            {
+                uint32_t pn, dn;
+                lookup(pos.hash_key(), pn, dn);
+                bool proven =   (!orNode || pos.in_check())
+                             && !pos.is_repetition()
+                             && pn == 0;
+                pos.undo_move(m);
+
+                if (proven)
+                {
+                    next = m;
+                    break;
+                }
+            }
+
+        if (next == MOVE_NONE)
+            break;
+
+        pos.do_move(next, states[pv.size()]);
+        pv.push_back(next);
+        orNode = !orNode;
+    }
+
+    for (auto it = pv.rbegin(); it != pv.rend(); ++it)
+        pos.undo_move(*it);
+
+    return pv;
+  }
+
+} // namespace
+
+
+/// Dfpn::solve() is called by the 'dfpn' command. It runs df-pn from the
+/// current position within the node limit, and reports whether a mate for the
+/// side to move is proven, disproven or unknown, with the proof line if any.
+
+void Dfpn::solve(Position& pos, std::istream& is) {
+
+  std::string token;
+  size_t hashMb = 64;
+
+  nodesLimit = 10000000;
+
+  while (is >> token)
+      if (token == "nodes")     is >> nodesLimit;
+      else if (token == "hash") is >> hashMb;
+
+  // Largest power of two number of entries within the memory limit
+  size_t entries = 1;
+  while (entries * 2 * sizeof(Entry) <= std::max(hashMb, size_t(1)) * 1024 * 1024)
+      entries *= 2;
+
+  table = static_cast<Entry*>(aligned_large_pages_alloc(entries * sizeof(Entry)));
+  if (!table)
+  {
+      sync_cout << "info string dfpn failed to allocate " << hashMb << "MB" << sync_endl;
+      return;
+  }
+
+  std::memset(static_cast<void*>(table), 0, entries * sizeof(Entry));
+  mask = entries - 1;
+  nodes = 0;
+  aborted = false;
+
+  TimePoint start = now();
+
+  mid(pos, Infinite, Infinite, true, 0);
+
+  TimePoint elapsed = now() - start + 1; // Ensure positivity to avoid a 'divide by zero'
+  uint32_t pn, dn;
+  lookup(pos.hash_key(), pn, dn);
+
+  std::stringstream ss;
+
+  if (pn == 0)
+  {
+      std::vector<Move> pv = proof_pv(pos);
+
+      // A complete line ends with the attacker's mating move
+      if (pv.size() % 2)
+          ss << "info depth " << pv.size()
+             << " score " << UCI::value(mate_in(int(pv.size()))) << " ";
+      else
+          ss << "info ";
+
+      ss << "nodes " << nodes
+         << " nps "  << nodes * 1000 / elapsed
+         << " time " << elapsed
+         << " pv";
+
+      for (Move m : pv)
+          ss << " " << UCI::move(m);
+
+      ss << "\ninfo string dfpn proven";
+  }
+  else
+      ss << "info nodes " << nodes
+         << " nps "  << nodes * 1000 / elapsed
+         << " time " << elapsed
+         << "\ninfo string dfpn " << (dn == 0 ? "disproven" : "unknown, node limit reached");
+
+  sync_cout << ss.str() << sync_endl;
+
+  aligned_large_pages_free(table);
+}
+
+} // namespace Stockfish
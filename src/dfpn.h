@@ -0,0 +1,44 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2021 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DFPN_H_INCLUDED
+#define DFPN_H_INCLUDED
+
+#include <istream>
+
+namespace Stockfish {
+
+class Position;
+
+/// Dfpn is a depth-first proof-number search solver for forced mates, run by
+/// the 'dfpn [nodes <n>] [hash <mb>]' command. The side to move is the
+/// attacker and tries only checking moves, the defender all its moves. Proof
+/// and disproof numbers live in a hash table of their own, allocated for the
+/// duration of the command, so the search transposition table is untouched.
+/// Unlike search(), no depth limit applies: the solver follows the most
+/// promising line as deep as it goes, which suits long forcing sequences.
+
+namespace Dfpn {
+
+void solve(Position& pos, std::istream& is);
+
+} // namespace Dfpn
+
+} // namespace Stockfish
+
+#endif // #ifndef DFPN_H_INCLUDED
@@ -18,6 +18,7 @@
 
 #include <iostream>
 #include "evaluate.h"
+#include "misc.h"
 #include "position.h"
 
 
@@ -112,27 +113,14 @@ const int PST[4][154] = {
 };
 
 // mirror square for black
-const int MIRROR_SQUARE[] = {
-  SQ_K14, SQ_J14, SQ_I14, SQ_H14, SQ_G14, SQ_F14, SQ_E14, SQ_D14, SQ_C14, SQ_B14, SQ_A14, 
-  SQ_K13, SQ_J13, SQ_I13, SQ_H13, SQ_G13, SQ_F13, SQ_E13, SQ_D13, SQ_C13, SQ_B13, SQ_A13, 
-  SQ_K12, SQ_J12, SQ_I12, SQ_H12, SQ_G12, SQ_F12, SQ_E12, SQ_D12, SQ_C12, SQ_B12, SQ_A12, 
-  SQ_K11, SQ_J11, SQ_I11, SQ_H11, SQ_G11, SQ_F11, SQ_E11, SQ_D11, SQ_C11, SQ_B11, SQ_A11, 
-  SQ_K10, SQ_J10, SQ_I10, SQ_H10, SQ_G10, SQ_F10, SQ_E10, SQ_D10, SQ_C10, SQ_B10, SQ_A10, 
-  SQ_K9, SQ_J9, SQ_I9, SQ_H9, SQ_G9, SQ_F9, SQ_E9, SQ_D9, SQ_C9, SQ_B9, SQ_A9, 
-  SQ_K8, SQ_J8, SQ_I8, SQ_H8, SQ_G8, SQ_F8, SQ_E8, SQ_D8, SQ_C8, SQ_B8, SQ_A8, 
-  SQ_K7, SQ_J7, SQ_I7, SQ_H7, SQ_G7, SQ_F7, SQ_E7, SQ_D7, SQ_C7, SQ_B7, SQ_A7, 
-  SQ_K6, SQ_J6, SQ_I6, SQ_H6, SQ_G6, SQ_F6, SQ_E6, SQ_D6, SQ_C6, SQ_B6, SQ_A6, 
-  SQ_K5, SQ_J5, SQ_I5, SQ_H5, SQ_G5, SQ_F5, SQ_E5, SQ_D5, SQ_C5, SQ_B5, SQ_A5, 
-  SQ_K4, SQ_J4, SQ_I4, SQ_H4, SQ_G4, SQ_F4, SQ_E4, SQ_D4, SQ_C4, SQ_B4, SQ_A4, 
-  SQ_K3, SQ_J3, SQ_I3, SQ_H3, SQ_G3, SQ_F3, SQ_E3, SQ_D3, SQ_C3, SQ_B3, SQ_A3, 
-  SQ_K2, SQ_J2, SQ_I2, SQ_H2, SQ_G2, SQ_F2, SQ_E2, SQ_D2, SQ_C2, SQ_B2, SQ_A2, 
-  SQ_K1, SQ_J1, SQ_I1, SQ_H1, SQ_G1, SQ_F1, SQ_E1, SQ_D1, SQ_C1, SQ_B1, SQ_A1
-};
+constexpr Square mirror(Square s) { return Square(SQUARE_NB - 1 - s); }
 
 /// evaluate() is the evaluator for the outer world. It returns a static
 /// evaluation of the position from the point of view of the side to move.
 
 Value Eval::evaluate(const Position& pos) {
+  TRACE_SCOPE(EVALUATE);
+
   Value score = (Value)0;
     
   for (Square square = SQ_A1; square < SQUARE_NB; ++square) {
@@ -151,10 +139,10 @@ Value Eval::evaluate(const Position& pos) {
           case W_CANNON: score += PST[2][square]; break;
           case W_ROOK: score += PST[3][square]; break;
           
-          case B_PAWN: score -= PST[0][MIRROR_SQUARE[square]]; break;
-          case B_KNIGHT: score -= PST[1][MIRROR_SQUARE[square]]; break;
-          case B_CANNON: score -= PST[2][MIRROR_SQUARE[square]]; break;
-          case B_ROOK: score -= PST[3][MIRROR_SQUARE[square]]; break;
+          case B_PAWN: score -= PST[0][mirror(square)]; break;
+          case B_KNIGHT: score -= PST[1][mirror(square)]; break;
+          case B_CANNON: score -= PST[2][mirror(square)]; break;
+          case B_ROOK: score -= PST[3][mirror(square)]; break;
         }        
       }
     }
@@ -18,8 +18,11 @@
 
 #include <iostream>
 
+#include "cluster.h"
+#include "misc.h"
 #include "position.h"
 #include "search.h"
+#include "thread.h"
 #include "uci.h"
 
 using namespace Stockfish;
@@ -28,7 +31,10 @@ int main(int argc, char* argv[]) {
   std::cout << engine_info() << std::endl; 
   CommandLine::init(argc, argv);
   UCI::init(Options);
-  Position::init();  
+  Search::init();
+  Threads.set(size_t(Options["Threads"]));
+  Search::clear(); // After threads are up
+  sync_cout << "info string " << large_pages_info() << sync_endl;
 
   /*Position pos;
   StateListPtr states(new std::deque<StateInfo>(1));
@@ -42,5 +48,7 @@ int main(int argc, char* argv[]) {
   
   UCI::loop(argc, argv);
 
+  Cluster::connect("");
+  Threads.set(0);
   return 0;
 }
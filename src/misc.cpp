@@ -39,18 +39,36 @@ typedef bool(*fun3_t)(HANDLE, CONST GROUP_AFFINITY*, PGROUP_AFFINITY);
 }
 #endif
 
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
 #include <vector>
 #include <cstdlib>
+#include <cstring>
 
 #if defined(__linux__) && !defined(__ANDROID__)
+#include <linux/mempolicy.h>
+#include <sched.h>
 #include <stdlib.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#ifndef _WIN32
 #include <sys/mman.h>
 #endif
 
+#if defined(USE_PERF_COUNTERS) && defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
 #if defined(__APPLE__) || defined(__ANDROID__) || defined(__OpenBSD__) || (defined(__GLIBCXX__) && !defined(_GLIBCXX_HAVE_ALIGNED_ALLOC) && !defined(_WIN32))
 #define POSIXALIGNEDALLOC
 #include <stdlib.h>
@@ -58,6 +76,12 @@ typedef bool(*fun3_t)(HANDLE, CONST GROUP_AFFINITY*, PGROUP_AFFINITY);
 
 #include "misc.h"
 
+#include <cmath>
+#include <deque>
+#include <limits>
+#include <map>
+#include <mutex>
+
 using namespace std;
 
 namespace Stockfish {
@@ -283,6 +307,167 @@ std::ostream& operator<<(std::ostream& os, SyncCout sc) {
 }
 
 
+/// Debug functions used mainly to collect run-time statistics. Each thread
+/// writes to its own DbgTable under a private, hence uncontended, lock that
+/// is taken by dbg_print() and dbg_clear() as well.
+
+namespace {
+
+constexpr int HistogramBuckets = 64;
+
+enum DbgKind { DBG_HIT = 1, DBG_MEAN = 2, DBG_HISTOGRAM = 4 };
+
+struct DbgEntry {
+  int kinds = 0;
+  int64_t total = 0, hits = 0, sum = 0;
+  int64_t min = std::numeric_limits<int64_t>::max();
+  int64_t max = std::numeric_limits<int64_t>::min();
+  double sumOfSquares = 0;
+  int64_t buckets[HistogramBuckets] = {};
+
+  void merge(const DbgEntry& e) {
+    kinds |= e.kinds;
+    total += e.total, hits += e.hits, sum += e.sum;
+    min = std::min(min, e.min), max = std::max(max, e.max);
+    sumOfSquares += e.sumOfSquares;
+    for (int i = 0; i < HistogramBuckets; ++i)
+        buckets[i] += e.buckets[i];
+  }
+};
+
+struct DbgTable {
+  std::mutex mutex;
+  std::map<std::pair<const char*, int>, DbgEntry> entries;
+};
+
+std::mutex dbgTablesMutex;
+std::deque<DbgTable> dbgTables;
+
+thread_local DbgTable* dbgTable = nullptr;
+
+DbgTable& local_table() {
+
+  if (!dbgTable)
+  {
+      std::lock_guard<std::mutex> lock(dbgTablesMutex);
+      dbgTable = &dbgTables.emplace_back();
+  }
+
+  return *dbgTable;
+}
+
+// Bucket 0 holds values <= 0, bucket i > 0 holds values in [2^(i-1), 2^i)
+int bucket_of(int64_t v) {
+  int b = 0;
+  while (v > 0 && b < HistogramBuckets - 1)
+      v >>= 1, ++b;
+  return b;
+}
+
+} // namespace
+
+void dbg_hit_on(bool b) { dbg_hit_on("Hit", b); }
+void dbg_hit_on(bool c, bool b) { if (c) dbg_hit_on(b); }
+void dbg_mean_of(int v) { dbg_mean_of("Mean", v); }
+
+void dbg_hit_on(const char* name, bool b, int slot) {
+
+  DbgTable& t = local_table();
+  std::lock_guard<std::mutex> lock(t.mutex);
+  DbgEntry& e = t.entries[{name, slot}];
+  e.kinds |= DBG_HIT;
+  ++e.total;
+  e.hits += b;
+}
+
+void dbg_mean_of(const char* name, int64_t v, int slot) {
+
+  DbgTable& t = local_table();
+  std::lock_guard<std::mutex> lock(t.mutex);
+  DbgEntry& e = t.entries[{name, slot}];
+  e.kinds |= DBG_MEAN;
+  ++e.total;
+  e.sum += v;
+  e.sumOfSquares += double(v) * v;
+  e.min = std::min(e.min, v);
+  e.max = std::max(e.max, v);
+}
+
+void dbg_histogram_of(const char* name, int64_t v, int slot) {
+
+  DbgTable& t = local_table();
+  std::lock_guard<std::mutex> lock(t.mutex);
+  DbgEntry& e = t.entries[{name, slot}];
+  e.kinds |= DBG_HISTOGRAM;
+  ++e.total;
+  ++e.buckets[bucket_of(v)];
+}
+
+void dbg_clear() {
+
+  std::lock_guard<std::mutex> lock(dbgTablesMutex);
+  for (DbgTable& t : dbgTables)
+  {
+      std::lock_guard<std::mutex> tableLock(t.mutex);
+      t.entries.clear();
+  }
+}
+
+void dbg_print() {
+
+  // Merge by name, not by address, as the same literal may be duplicated
+  // across translation units.
+  std::map<std::pair<string, int>, DbgEntry> merged;
+
+  {
+      std::lock_guard<std::mutex> lock(dbgTablesMutex);
+      for (DbgTable& t : dbgTables)
+      {
+          std::lock_guard<std::mutex> tableLock(t.mutex);
+          for (const auto& [key, e] : t.entries)
+              merged[{key.first, key.second}].merge(e);
+      }
+  }
+
+  for (const auto& [key, e] : merged)
+  {
+      string name = key.first + (key.second ? "[" + std::to_string(key.second) + "]" : "");
+
+      if (e.kinds & DBG_HIT)
+          cerr << name << ": Total " << e.total << " Hits " << e.hits
+               << " hit rate (%) " << 100 * e.hits / std::max(e.total, int64_t(1)) << endl;
+
+      if ((e.kinds & DBG_MEAN) && e.total)
+      {
+          double mean = double(e.sum) / e.total;
+          double variance = std::max(e.sumOfSquares / e.total - mean * mean, 0.0);
+
+          cerr << name << ": Total " << e.total << " Mean " << mean
+               << " Min " << e.min << " Max " << e.max
+               << " Stddev " << std::sqrt(variance) << endl;
+      }
+
+      if (e.kinds & DBG_HISTOGRAM)
+      {
+          cerr << name << ": Total " << e.total << " Histogram";
+          for (int i = 0; i < HistogramBuckets; ++i)
+              if (e.buckets[i])
+              {
+                  cerr << " [";
+                  if (i == 0)
+                      cerr << "<=0";
+                  else if (i == 1)
+                      cerr << "1";
+                  else
+                      cerr << (int64_t(1) << (i - 1)) << "-" << (int64_t(1) << i) - 1;
+                  cerr << "]:" << e.buckets[i];
+              }
+          cerr << endl;
+      }
+  }
+}
+
+
 /// Trampoline helper to avoid moving Logger to misc.h
 void start_logger(const std::string& fname) { Logger::start(fname); }
 
@@ -341,11 +526,62 @@ void std_aligned_free(void* ptr) {
 #endif
 }
 
+namespace {
+
+/// The blocks returned by aligned_large_pages_alloc(), with the kind of pages
+/// backing them, for large_pages_info() and lock_large_pages().
+
+enum PageKind { HUGE_1GB, HUGE_2MB, TRANSPARENT, LARGE, NORMAL, PAGE_KIND_NB };
+
+struct PagesBlock {
+  size_t size;
+  PageKind kind;
+  bool locked;
+};
+
+// Never destroyed: the global transposition table frees its memory after the
+// other statics are gone.
+std::mutex blocksMutex;
+std::map<void*, PagesBlock>& blocks = *new std::map<void*, PagesBlock>();
+bool lockMemory;
+
+bool lock_block(void* mem, PagesBlock& b, bool lock) {
+
+  if (b.kind == HUGE_1GB || b.kind == HUGE_2MB || b.kind == LARGE)
+      return b.locked = true; // Never paged out
+
+#if defined(_WIN32)
+  b.locked = lock ? VirtualLock(mem, b.size) != 0 : (VirtualUnlock(mem, b.size), false);
+#else
+  b.locked = lock ? !mlock(mem, b.size) : (munlock(mem, b.size), false);
+#endif
+
+  return b.locked == lock;
+}
+
+void* register_block(void* mem, size_t size, PageKind kind) {
+
+  if (mem)
+  {
+      std::lock_guard<std::mutex> lk(blocksMutex);
+      bool pinned = kind == HUGE_1GB || kind == HUGE_2MB || kind == LARGE;
+      PagesBlock& b = blocks[mem] = PagesBlock{ size, kind, pinned };
+
+      if (lockMemory)
+          lock_block(mem, b, true);
+  }
+
+  return mem;
+}
+
+} // namespace
+
+
 /// aligned_large_pages_alloc() will return suitably aligned memory, if possible using large pages.
 
 #if defined(_WIN32)
 #if defined(_WIN64)
-static void* aligned_large_pages_alloc_win(size_t allocSize) {
+static void* aligned_large_pages_alloc_win(size_t& allocSize) {
 
   HANDLE hProcessToken { };
   LUID luid { };
@@ -395,35 +631,78 @@ void* aligned_large_pages_alloc(size_t allocSize) {
 
 #if defined(_WIN64)
   // Try to allocate large pages
-  void* mem = aligned_large_pages_alloc_win(allocSize);
+  size_t largeSize = allocSize;
+  if (void* mem = aligned_large_pages_alloc_win(largeSize))
+      return register_block(mem, largeSize, LARGE);
+#endif
 
   // Fall back to regular, page aligned, allocation if necessary
-  if (!mem)
-      mem = VirtualAlloc(NULL, allocSize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
-#else
   void* mem = VirtualAlloc(NULL, allocSize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+  return register_block(mem, allocSize, NORMAL);
+}
+
+#elif defined(__linux__) && !defined(__ANDROID__)
+
+/// On Linux we try, in order, explicit huge pages from the hugetlbfs pool
+/// (1GB pages only for blocks of at least 1GB), which the administrator must
+/// have reserved, then transparent huge pages, which the kernel may or may not
+/// provide, then normal pages. The memory comes straight from mmap(), is zeroed
+/// and, except for the pool, committed only when first touched.
+
+static void* map_pages(size_t size, int flags) {
+
+  void* mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | flags, -1, 0);
+  return mem == MAP_FAILED ? nullptr : mem;
+}
+
+void* aligned_large_pages_alloc(size_t allocSize) {
+
+  constexpr size_t HugePage = 2 * 1024 * 1024, GigaPage = 1024 * 1024 * 1024;
+
+  size_t size = (allocSize + HugePage - 1) / HugePage * HugePage;
+  void* mem;
+
+#if defined(MAP_HUGETLB) && defined(MAP_HUGE_SHIFT)
+  size_t gigaSize = (allocSize + GigaPage - 1) / GigaPage * GigaPage;
+
+  if (   allocSize >= GigaPage
+      && (mem = map_pages(gigaSize, MAP_HUGETLB | (30 << MAP_HUGE_SHIFT))))
+      return register_block(mem, gigaSize, HUGE_1GB);
+
+  if ((mem = map_pages(size, MAP_HUGETLB | (21 << MAP_HUGE_SHIFT))))
+      return register_block(mem, size, HUGE_2MB);
 #endif
 
-  return mem;
+  // Map one more huge page and trim both ends to align the block, so that the
+  // kernel can back it with transparent huge pages.
+  char* raw = static_cast<char*>(map_pages(size + HugePage, 0));
+  if (!raw)
+      return nullptr;
+
+  char* aligned = raw + (HugePage - uintptr_t(raw) % HugePage) % HugePage;
+
+  if (aligned > raw)
+      munmap(raw, aligned - raw);
+  munmap(aligned + size, raw + HugePage - aligned);
+
+#if defined(MADV_HUGEPAGE)
+  if (!madvise(aligned, size, MADV_HUGEPAGE))
+      return register_block(aligned, size, TRANSPARENT);
+#endif
+
+  return register_block(aligned, size, NORMAL);
 }
 
 #else
 
 void* aligned_large_pages_alloc(size_t allocSize) {
 
-#if defined(__linux__)
-  constexpr size_t alignment = 2 * 1024 * 1024; // assumed 2MB page size
-#else
   constexpr size_t alignment = 4096; // assumed small page size
-#endif
 
   // round up to multiples of alignment
   size_t size = ((allocSize + alignment - 1) / alignment) * alignment;
   void *mem = std_aligned_alloc(alignment, size);
-#if defined(MADV_HUGEPAGE)
-  madvise(mem, size, MADV_HUGEPAGE);
-#endif
-  return mem;
+  return register_block(mem, size, NORMAL);
 }
 
 #endif
@@ -431,31 +710,498 @@ void* aligned_large_pages_alloc(size_t allocSize) {
 
 /// aligned_large_pages_free() will free the previously allocated ttmem
 
-#if defined(_WIN32)
-
 void aligned_large_pages_free(void* mem) {
 
-  if (mem && !VirtualFree(mem, 0, MEM_RELEASE))
+  if (!mem)
+      return;
+
+  std::unique_lock<std::mutex> lk(blocksMutex);
+  auto it = blocks.find(mem);
+  assert(it != blocks.end());
+  size_t size = it->second.size;
+  blocks.erase(it);
+  lk.unlock();
+
+#if defined(_WIN32)
+  (void)size;
+
+  if (!VirtualFree(mem, 0, MEM_RELEASE))
   {
       DWORD err = GetLastError();
       std::cerr << "Failed to free transposition table. Error code: 0x" <<
           std::hex << err << std::dec << std::endl;
       exit(EXIT_FAILURE);
   }
+#elif defined(__linux__) && !defined(__ANDROID__)
+  munmap(mem, size);
+#else
+  (void)size;
+  std_aligned_free(mem);
+#endif
+}
+
+
+/// lock_large_pages() is called when the "Lock Memory" option changes. It
+/// locks (or unlocks) the blocks in RAM, so that they are never swapped out,
+/// and does the same for the blocks allocated later. It returns false if the
+/// OS refused, usually because of the RLIMIT_MEMLOCK limit.
+
+bool lock_large_pages(bool lock) {
+
+  std::lock_guard<std::mutex> lk(blocksMutex);
+  bool ok = true;
+
+  lockMemory = lock;
+
+  for (auto& b : blocks)
+      ok &= lock_block(b.first, b.second, lock);
+
+  return ok;
+}
+
+
+/// large_pages_info() describes the memory of the blocks allocated with
+/// aligned_large_pages_alloc(), by kind of pages. For transparent huge pages,
+/// which are a hint only, it also reports from /proc/self/smaps the share that
+/// the kernel actually backs with huge pages, among the pages touched so far.
+
+std::string large_pages_info() {
+
+  constexpr const char* KindNames[PAGE_KIND_NB] = {
+    "1GB huge pages", "2MB huge pages", "transparent huge pages", "large pages", "normal pages"
+  };
+
+  std::lock_guard<std::mutex> lk(blocksMutex);
+  size_t bytes[PAGE_KIND_NB] = {}, total = 0, locked = 0, backed = 0;
+
+  for (const auto& b : blocks)
+  {
+      bytes[b.second.kind] += b.second.size;
+      total += b.second.size;
+      locked += b.second.locked ? b.second.size : 0;
+  }
+
+#if defined(__linux__) && !defined(__ANDROID__)
+  if (bytes[TRANSPARENT])
+  {
+      std::ifstream smaps("/proc/self/smaps");
+      std::string line;
+      uintptr_t start = 0, end = 0;
+      size_t kb;
+
+      while (std::getline(smaps, line))
+      {
+          unsigned long long s, e;
+
+          if (sscanf(line.c_str(), "%llx-%llx ", &s, &e) == 2)
+              start = uintptr_t(s), end = uintptr_t(e);
+
+          else if (sscanf(line.c_str(), "AnonHugePages: %zu kB", &kb) == 1 && kb)
+              for (const auto& b : blocks)
+              {
+                  uintptr_t first = std::max(start, uintptr_t(b.first));
+                  uintptr_t last = std::min(end, uintptr_t(b.first) + b.second.size);
+
+                  if (b.second.kind == TRANSPARENT && first < last)
+                      backed += std::min(kb * 1024, size_t(last - first));
+              }
+      }
+  }
+#endif
+
+  std::stringstream ss;
+  ss << "Memory: " << (total >> 20) << "MB in " << blocks.size() << " blocks";
+
+  for (int k = HUGE_1GB; k < PAGE_KIND_NB; ++k)
+      if (bytes[k])
+      {
+          ss << ", " << (bytes[k] >> 20) << "MB on " << KindNames[k];
+
+          if (k == TRANSPARENT)
+              ss << " (" << (backed >> 20) << "MB backed so far)";
+      }
+
+  if (locked)
+      ss << ", " << (locked >> 20) << "MB locked";
+
+  return ss.str();
+}
+
+
+/// PerfCounters counts the events of the search threads, user space only. A
+/// counter opened on a thread counts that thread alone, and a counter inherited
+/// by the threads spawned later would miss the pool threads, which exist before
+/// any measurement. So every search thread opens its own counters, once, with
+/// register_thread(), and a measurement is the difference of the sums over the
+/// threads at start() and stop(). The counts of the threads that have exited are
+/// kept. Events that are not supported by the CPU or denied by
+/// perf_event_paranoid are reported as "n/a".
+
+#if defined(USE_PERF_COUNTERS) && defined(__linux__)
+
+namespace {
+
+const char* EventNames[PerfCounters::EVENT_NB] = {
+  "cycles", "instructions", "cache-references", "cache-misses",
+  "branches", "branch-misses", "dTLB-load-misses"
+};
+
+int perf_event_open(uint32_t type, uint64_t config) {
+
+  perf_event_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+
+  return int(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+uint64_t read_counter(int fd) {
+
+  uint64_t v;
+  return read(fd, &v, sizeof(v)) == sizeof(v) ? v : 0;
+}
+
+struct ThreadCounters;
+
+std::mutex countersMutex;
+std::vector<ThreadCounters*> liveCounters;
+uint64_t retired[PerfCounters::EVENT_NB];
+bool opened[PerfCounters::EVENT_NB];
+
+struct ThreadCounters {
+
+  int fd[PerfCounters::EVENT_NB];
+
+  ThreadCounters() {
+
+    constexpr uint64_t DTlbReadMiss =  PERF_COUNT_HW_CACHE_DTLB
+                                    | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                                    | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+
+    fd[PerfCounters::CYCLES]           = perf_event_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    fd[PerfCounters::INSTRUCTIONS]     = perf_event_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    fd[PerfCounters::CACHE_REFERENCES] = perf_event_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES);
+    fd[PerfCounters::CACHE_MISSES]     = perf_event_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    fd[PerfCounters::BRANCHES]         = perf_event_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS);
+    fd[PerfCounters::BRANCH_MISSES]    = perf_event_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+    fd[PerfCounters::DTLB_MISSES]      = perf_event_open(PERF_TYPE_HW_CACHE, DTlbReadMiss);
+
+    std::lock_guard<std::mutex> lock(countersMutex);
+    for (int e = 0; e < PerfCounters::EVENT_NB; ++e)
+        opened[e] |= fd[e] != -1;
+    liveCounters.push_back(this);
+  }
+
+  ~ThreadCounters() {
+
+    std::lock_guard<std::mutex> lock(countersMutex);
+    for (int e = 0; e < PerfCounters::EVENT_NB; ++e)
+        if (fd[e] != -1)
+            retired[e] += read_counter(fd[e]), close(fd[e]);
+    liveCounters.erase(std::find(liveCounters.begin(), liveCounters.end(), this));
+  }
+};
+
+// Sums the counts of all the threads, past and present
+void read_all(uint64_t* sum) {
+
+  std::lock_guard<std::mutex> lock(countersMutex);
+  std::copy(retired, retired + PerfCounters::EVENT_NB, sum);
+
+  for (const ThreadCounters* tc : liveCounters)
+      for (int e = 0; e < PerfCounters::EVENT_NB; ++e)
+          if (tc->fd[e] != -1)
+              sum[e] += read_counter(tc->fd[e]);
+}
+
+} // namespace
+
+void PerfCounters::register_thread() {
+
+  thread_local ThreadCounters counters;
+  (void)counters;
+}
+
+PerfCounters::PerfCounters() {
+
+  std::fill(count, count + EVENT_NB, 0);
+}
+
+void PerfCounters::start() {
+
+  read_all(count);
+}
+
+void PerfCounters::stop() {
+
+  uint64_t end[EVENT_NB];
+  read_all(end);
+
+  for (int e = 0; e < EVENT_NB; ++e)
+      count[e] = end[e] - count[e];
+}
+
+void PerfCounters::print(const string& title, uint64_t nodes) const {
+
+  std::stringstream ss;
+  nodes = std::max(nodes, uint64_t(1));
+
+  ss << "\n" << title << " (total / per node)\n" << std::fixed << std::setprecision(2);
+
+  for (int e = 0; e < EVENT_NB; ++e)
+  {
+      ss << std::left << std::setw(18) << EventNames[e] << ": " << std::right;
+
+      if (!opened[e])
+          ss << std::setw(16) << "n/a" << "\n";
+      else
+          ss << std::setw(16) << count[e]
+             << std::setw(12) << double(count[e]) / nodes << "\n";
+  }
+
+  if (opened[CYCLES] && opened[INSTRUCTIONS] && count[CYCLES])
+      ss << std::left << std::setw(18) << "IPC" << ": "
+         << double(count[INSTRUCTIONS]) / count[CYCLES] << "\n";
+
+  if (opened[BRANCHES] && opened[BRANCH_MISSES] && count[BRANCHES])
+      ss << std::left << std::setw(18) << "branch-miss %" << ": "
+         << 100.0 * count[BRANCH_MISSES] / count[BRANCHES] << "\n";
+
+  if (opened[CACHE_REFERENCES] && opened[CACHE_MISSES] && count[CACHE_REFERENCES])
+      ss << std::left << std::setw(18) << "cache-miss %" << ": "
+         << 100.0 * count[CACHE_MISSES] / count[CACHE_REFERENCES] << "\n";
+
+  cerr << ss.str() << endl;
 }
 
 #else
 
-void aligned_large_pages_free(void *mem) {
-  std_aligned_free(mem);
+void PerfCounters::register_thread() {}
+PerfCounters::PerfCounters() {}
+void PerfCounters::start() {}
+void PerfCounters::stop() {}
+void PerfCounters::print(const string&, uint64_t) const {}
+
+#endif
+
+
+/// Tracing::register_thread() hands out the profile of a new thread. Profiles
+/// are never released, so that the counts of a thread that has exited still
+/// show up in the merged output.
+
+namespace Tracing {
+
+#if defined(USE_TRACING)
+
+namespace {
+
+const char* SectionNames[SECTION_NB] = {
+  "movegen", "do_move", "undo_move", "is_square_attacked", "evaluate", "search"
+};
+
+std::mutex profilesMutex;
+std::deque<ThreadProfile> profiles;
+
+} // namespace
+
+ThreadProfile* register_thread() {
+
+  std::lock_guard<std::mutex> lock(profilesMutex);
+  profiles.emplace_back();
+  std::memset(&profiles.back(), 0, sizeof(ThreadProfile));
+  return &profiles.back();
+}
+
+void clear() {
+
+  std::lock_guard<std::mutex> lock(profilesMutex);
+  for (ThreadProfile& p : profiles)
+      std::fill(p.ticks, p.ticks + SECTION_NB, 0),
+      std::fill(p.calls, p.calls + SECTION_NB, 0);
+}
+
+void print() {
+
+  uint64_t ticks[SECTION_NB] = {}, calls[SECTION_NB] = {}, total = 0;
+
+  {
+      std::lock_guard<std::mutex> lock(profilesMutex);
+      for (const ThreadProfile& p : profiles)
+          for (int s = 0; s < SECTION_NB; ++s)
+              ticks[s] += p.ticks[s], calls[s] += p.calls[s];
+  }
+
+  for (int s = 0; s < SECTION_NB; ++s)
+      total += ticks[s];
+
+  std::stringstream ss;
+  ss << "Flat profile, self time in "
+#if defined(TRACING_USE_RDTSC)
+     << "rdtsc ticks"
+#else
+     << "nanoseconds"
+#endif
+     << "\n\n" << std::left << std::setw(20) << "section" << std::right
+     << std::setw(14) << "calls" << std::setw(16) << "self"
+     << std::setw(12) << "per call" << std::setw(9) << "%" << "\n"
+     << std::fixed << std::setprecision(1);
+
+  for (int s = 0; s < SECTION_NB; ++s)
+      ss << std::left << std::setw(20) << SectionNames[s] << std::right
+         << std::setw(14) << calls[s] << std::setw(16) << ticks[s]
+         << std::setw(12) << (calls[s] ? double(ticks[s]) / calls[s] : 0.0)
+         << std::setw(9)  << (total ? 100.0 * ticks[s] / total : 0.0) << "\n";
+
+  sync_cout << ss.str() << sync_endl;
+}
+
+#else
+
+void clear() {}
+
+void print() {
+  sync_cout << "Tracing is not compiled in, rebuild with 'make tracing=yes'" << sync_endl;
 }
 
 #endif
 
+} // namespace Tracing
+
+
+#if defined(__linux__) && !defined(__ANDROID__)
+
+namespace {
+
+/// read_cpu_list() parses a list of processors or nodes from sysfs, in the
+/// form "0-7,16-23". It returns an empty list if the file cannot be read.
+
+std::vector<int> read_cpu_list(const std::string& fname) {
+
+  std::ifstream file(fname);
+  std::string list, range;
+  std::vector<int> ids;
+
+  if (!std::getline(file, list))
+      return ids;
+
+  std::istringstream ss(list);
+
+  while (std::getline(ss, range, ','))
+  {
+      size_t dash = range.find('-');
+      int first = std::atoi(range.c_str());
+      int last = dash == std::string::npos ? first : std::atoi(range.c_str() + dash + 1);
+
+      for (int id = first; id <= last; ++id)
+          ids.push_back(id);
+  }
+
+  return ids;
+}
+
+/// cpu_order() returns the processors the process may run on, in the order
+/// the threads are bound to them: the first processor of every core, node by
+/// node, then the other processors of the cores (SMT siblings) spread evenly
+/// over the nodes. It is empty with less than two NUMA nodes, where binding
+/// buys nothing over the scheduler.
+
+std::vector<int> cpu_order() {
+
+  cpu_set_t allowed;
+  std::vector<int> nodes = read_cpu_list("/sys/devices/system/node/online");
+  std::vector<int> order;
+  std::vector<std::pair<size_t, int>> siblings; // (rank in node * nodes + node, cpu)
+
+  if (nodes.size() < 2 || sched_getaffinity(0, sizeof(allowed), &allowed))
+      return order;
+
+  for (size_t n = 0; n < nodes.size(); ++n)
+  {
+      size_t rank = 0;
+
+      for (int cpu : read_cpu_list("/sys/devices/system/node/node" + std::to_string(nodes[n]) + "/cpulist"))
+      {
+          if (cpu >= CPU_SETSIZE || !CPU_ISSET(cpu, &allowed))
+              continue;
+
+          std::vector<int> smt = read_cpu_list("/sys/devices/system/cpu/cpu" + std::to_string(cpu)
+                                               + "/topology/thread_siblings_list");
+
+          if (smt.empty() || smt[0] == cpu)
+              order.push_back(cpu);
+          else
+              siblings.emplace_back(rank++ * nodes.size() + n, cpu);
+      }
+  }
+
+  std::stable_sort(siblings.begin(), siblings.end());
+
+  for (const auto& s : siblings)
+      order.push_back(s.second);
+
+  return order;
+}
+
+} // namespace
+
+#endif
+
+
+/// numa_interleave() spreads the pages of the given memory, which must be page
+/// aligned, evenly over the NUMA nodes, so that the threads of every node get
+/// the same share of local accesses. It does nothing without several nodes,
+/// and is implemented for Linux only.
+
+void numa_interleave(void* mem, size_t size) {
+
+#if defined(__linux__) && !defined(__ANDROID__)
+  std::vector<int> nodes = read_cpu_list("/sys/devices/system/node/online");
+  unsigned long mask[16] = {};
+  constexpr size_t MaskBits = 8 * sizeof(mask);
+
+  if (!mem || nodes.size() < 2)
+      return;
+
+  for (int n : nodes)
+      if (size_t(n) < MaskBits)
+          mask[n / (8 * sizeof(long))] |= 1UL << (n % (8 * sizeof(long)));
+
+  syscall(SYS_mbind, mem, size, MPOL_INTERLEAVE, mask, MaskBits, 0);
+#else
+  (void)mem, (void)size;
+#endif
+}
+
 
 namespace WinProcGroup {
 
-#ifndef _WIN32
+#if defined(__linux__) && !defined(__ANDROID__)
+
+/// On Linux bindThisThread() pins the current thread to a single processor,
+/// chosen from the NUMA topology found in sysfs as done for the Windows
+/// processor groups below, whatever the number of threads, as soon as there
+/// are several NUMA nodes. The thread then first touches its own tables,
+/// which the kernel places in the memory of its node.
+
+void bindThisThread(size_t idx) {
+
+  static const std::vector<int> order = cpu_order();
+
+  // A single node, or more threads than processors: let the OS decide
+  if (idx >= order.size())
+      return;
+
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(order[idx], &set);
+  sched_setaffinity(0, sizeof(set), &set); // 0 is the calling thread
+}
+
+#elif !defined(_WIN32)
 
 void bindThisThread(size_t) {}
 
@@ -28,6 +28,11 @@
 
 #include "types.h"
 
+#if defined(USE_TRACING) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#  include <x86intrin.h> // Header for __rdtsc()
+#  define TRACING_USE_RDTSC
+#endif
+
 namespace Stockfish {
 
 std::string engine_info(bool to_uci = false);
@@ -38,11 +43,129 @@ void* std_aligned_alloc(size_t alignment, size_t size);
 void std_aligned_free(void* ptr);
 void* aligned_large_pages_alloc(size_t size); // memory aligned by page size, min alignment: 4096 bytes
 void aligned_large_pages_free(void* mem); // nop if mem == nullptr
+bool lock_large_pages(bool lock);
+std::string large_pages_info();
+void numa_interleave(void* mem, size_t size);
+
+/// Debug statistics. Every thread accumulates into its own table, which is
+/// merged by dbg_print(). Named entries are keyed by the address of 'name', so
+/// it must be a string literal; 'slot' splits an entry further, e.g. by depth.
+/// dbg_mean_of() also tracks min, max and standard deviation, dbg_histogram_of()
+/// counts values in power-of-two buckets.
 
 void dbg_hit_on(bool b);
 void dbg_hit_on(bool c, bool b);
 void dbg_mean_of(int v);
+void dbg_hit_on(const char* name, bool b, int slot = 0);
+void dbg_mean_of(const char* name, int64_t v, int slot = 0);
+void dbg_histogram_of(const char* name, int64_t v, int slot = 0);
 void dbg_print();
+void dbg_clear();
+
+/// PerfCounters reads Linux hardware performance counters (cycles, instructions,
+/// cache, branch and TLB misses) over a bench, perft or search run, so that the
+/// effect of layout changes can be seen behind the raw nps. The counts are
+/// summed over the search threads, each of which must call register_thread().
+/// It is compiled in only with 'make perfcounters=yes', otherwise it does
+/// nothing.
+
+class PerfCounters {
+public:
+  enum Event {
+    CYCLES, INSTRUCTIONS, CACHE_REFERENCES, CACHE_MISSES,
+    BRANCHES, BRANCH_MISSES, DTLB_MISSES, EVENT_NB
+  };
+
+  static void register_thread();
+
+  PerfCounters();
+  PerfCounters(const PerfCounters&) = delete;
+  PerfCounters& operator=(const PerfCounters&) = delete;
+
+  void start();
+  void stop();
+  void print(const std::string& title, uint64_t nodes) const;
+
+private:
+  uint64_t count[EVENT_NB];
+};
+
+/// Tracing is a scoped cycle-count profiler for the small, heavily inlined hot
+/// paths that sampling profilers attribute poorly. A TRACE_SCOPE(section) at
+/// the top of a function accumulates its self time (time spent in nested
+/// traced scopes is charged to those) and its call count in a per-thread
+/// profile. Tracing::print() merges all the threads into a flat profile. It is
+/// compiled in only with 'make tracing=yes', otherwise TRACE_SCOPE expands to
+/// nothing.
+
+namespace Tracing {
+
+enum Section {
+  MOVEGEN, DO_MOVE, UNDO_MOVE, IS_SQUARE_ATTACKED, EVALUATE, SEARCH, SECTION_NB
+};
+
+void print();
+void clear();
+
+#if defined(USE_TRACING)
+
+inline uint64_t ticks() {
+#if defined(TRACING_USE_RDTSC)
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>
+        (std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+class ScopedTimer;
+
+struct ThreadProfile {
+  uint64_t ticks[SECTION_NB];
+  uint64_t calls[SECTION_NB];
+  ScopedTimer* current;
+};
+
+ThreadProfile* register_thread();
+inline thread_local ThreadProfile* Profile = nullptr;
+
+class ScopedTimer {
+public:
+  explicit ScopedTimer(Section s) : section(s), children(0) {
+    if (!Profile)
+        Profile = register_thread();
+    parent = Profile->current;
+    Profile->current = this;
+    start = ticks();
+  }
+
+ ~ScopedTimer() {
+    uint64_t elapsed = ticks() - start;
+    Profile->ticks[section] += elapsed - children;
+    Profile->calls[section]++;
+    Profile->current = parent;
+    if (parent)
+        parent->children += elapsed;
+  }
+
+  ScopedTimer(const ScopedTimer&) = delete;
+  ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+  Section section;
+  ScopedTimer* parent;
+  uint64_t start, children;
+};
+
+#define TRACE_SCOPE(s) Tracing::ScopedTimer traceScope(Tracing::s)
+
+#else
+
+#define TRACE_SCOPE(s)
+
+#endif
+
+} // namespace Tracing
 
 typedef std::chrono::milliseconds::rep TimePoint; // A value in milliseconds
 static_assert(sizeof(TimePoint) == sizeof(int64_t), "TimePoint should be 64 bits");
@@ -97,16 +220,16 @@ class PRNG {
 
   uint64_t s;
 
-  uint64_t rand64() {
+  constexpr uint64_t rand64() {
 
     s ^= s >> 12, s ^= s << 25, s ^= s >> 27;
     return s * 2685821657736338717LL;
   }
 
 public:
-  PRNG(uint64_t seed) : s(seed) { assert(seed); }
+  constexpr PRNG(uint64_t seed) : s(seed) { assert(seed); }
 
-  template<typename T> T rand() { return T(rand64()); }
+  template<typename T> constexpr T rand() { return T(rand64()); }
 
   /// Special generator used to fast init magic numbers.
   /// Output values only have 1/8th of their bits set on average.
@@ -132,7 +255,8 @@ inline uint64_t mul_hi64(uint64_t a, uint64_t b) {
 /// logical processor group. This usually means to be limited to use max 64
 /// cores. To overcome this, some special platform specific API should be
 /// called to set group affinity for each thread. Original code from Texel by
-/// Peter Österlund.
+/// Peter Österlund. Under Linux the threads are pinned to processors following
+/// the NUMA topology.
 
 namespace WinProcGroup {
   void bindThisThread(size_t idx);
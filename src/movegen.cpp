@@ -18,6 +18,7 @@
 
 #include <cassert>
 
+#include "misc.h"
 #include "movegen.h"
 #include "position.h"
 
@@ -149,6 +150,8 @@ static ExtMove* generateMoves(const Position& pos, ExtMove* moveList, bool onlyC
 // generate <PSEUDO_LEGAL> generates all the pseudo legal moves
 template<>
 ExtMove* generate<PSEUDO_LEGAL>(const Position& pos, ExtMove* moveList) {
+  TRACE_SCOPE(MOVEGEN);
+
   // generate pseudo legal moves 
   return generateMoves(pos, moveList, false);
 }
@@ -156,6 +159,8 @@ ExtMove* generate<PSEUDO_LEGAL>(const Position& pos, ExtMove* moveList) {
 // generate <CAPTURES> generates all the pseudo legal captures
 template<>
 ExtMove* generate<CAPTURES>(const Position& pos, ExtMove* moveList) {
+  TRACE_SCOPE(MOVEGEN);
+
   // generate pseudo legal moves 
   return generateMoves(pos, moveList, true);
 }
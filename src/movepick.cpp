@@ -0,0 +1,123 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2021 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cassert>
+
+#include "movepick.h"
+
+namespace Stockfish {
+
+namespace {
+
+  // Piece values by type used to order captures, on the scale of evaluate()
+  constexpr int PieceValue[PIECE_TYPE_NB] = {
+    0, 30, 120, 120, 270, 285, 600, 6000, 0
+  };
+
+  // The hash move is tried first, then captures before quiet moves
+  constexpr int TTMoveBonus = 1 << 21;
+  constexpr int CaptureBonus = 1 << 20;
+  constexpr int KillerBonus = 1 << 19;
+  constexpr int CounterMoveBonus = 1 << 18;
+
+} // namespace
+
+
+/// Constructors of the MovePicker class. As arguments we pass information
+/// to help it to return the (presumably) good moves first, to decide which
+/// moves to return and how to sort them.
+
+MovePicker::MovePicker(const Position& p, Move ttm, const ButterflyHistory* mh,
+                       const CapturePieceToHistory* cph,
+                       const PieceToHistory** ch,
+                       Move cm,
+                       const Move* killerMoves)
+           : pos(p), mainHistory(mh), captureHistory(cph), continuationHistory(ch),
+             ttMove(Move(ttm & 0xFFFF)), counterMove(cm), killers{killerMoves[0], killerMoves[1]} {
+
+  cur = moves;
+  endMoves = generate<PSEUDO_LEGAL>(pos, cur);
+  score();
+}
+
+/// MovePicker constructor for quiescence search
+MovePicker::MovePicker(const Position& p, const CapturePieceToHistory* cph)
+           : pos(p), captureHistory(cph), ttMove(MOVE_NONE) {
+
+  cur = moves;
+  endMoves = generate<CAPTURES>(pos, cur);
+  score();
+}
+
+
+/// MovePicker::score() assigns a numerical value to each move in the list,
+/// used for sorting. The hash move, known only by its squares, comes first.
+/// Captures are ordered by Most Valuable Victim (MVV), breaking ties by Least
+/// Valuable Attacker (LVA) and capture history. Quiets are ordered using the
+/// history tables.
+
+void MovePicker::score() {
+
+  Color us = pos.side_to_move();
+
+  for (auto& m : *this)
+  {
+      Square from = move_source_square(m);
+      Square to = move_target_square(m);
+      Piece pc = move_source_piece(m);
+
+      if ((m & 0xFFFF) == ttMove)
+          m.value = TTMoveBonus;
+
+      else if (move_capture_flag(m))
+      {
+          PieceType captured = PIECE_TYPE[move_target_piece(m)];
+
+          m.value =  CaptureBonus
+                   + 16 * PieceValue[captured]
+                   - PieceValue[PIECE_TYPE[pc]] / 16
+                   + (*captureHistory)[pc][to][captured] / 16;
+      }
+      else
+          m.value =      (*mainHistory)[us][from][to]
+                   +     (*continuationHistory[0])[pc][to]
+                   +     (*continuationHistory[1])[pc][to]
+                   + (m == killers[0]) * (KillerBonus + 1)
+                   + (m == killers[1]) * KillerBonus
+                   + (m == counterMove && m != killers[0] && m != killers[1]) * CounterMoveBonus;
+  }
+}
+
+
+/// MovePicker::next_move() is the most important method of the MovePicker
+/// class. It returns a new pseudo-legal move every time it is called until
+/// there are no more moves left, picking the move with the highest score
+/// among the remaining ones. Moves are sorted lazily because most nodes are
+/// cut off after a few moves.
+
+Move MovePicker::next_move() {
+
+  if (cur == endMoves)
+      return MOVE_NONE;
+
+  std::swap(*cur, *std::max_element(cur, endMoves));
+
+  return *cur++;
+}
+
+} // namespace Stockfish
@@ -32,11 +32,6 @@ using std::string;
 
 namespace Stockfish {
 
-namespace Zobrist {
-  Key psq[PIECE_NB][SQUARE_NB];
-  Key side;
-}
-
 namespace {
 
 // offboard map
@@ -62,6 +57,26 @@ const string PieceToChar(" PABNCRKpabncrkx");
 constexpr Piece Pieces[] = {
   W_PAWN, W_ADVISOR, W_KNIGHT, W_BISHOP, W_ROOK, W_CANNON, W_KING,
   B_PAWN, B_ADVISOR, B_KNIGHT, B_BISHOP, B_ROOK, B_CANNON, B_KING, };
+
+// The keys used to compute hash keys, drawn from the PRNG at compile time
+struct ZobristKeys {
+  Key psq[PIECE_NB][SQUARE_NB];
+  Key side;
+};
+
+constexpr ZobristKeys Zobrist = [] {
+  ZobristKeys keys{};
+  PRNG rng(1070372);
+
+  for (Piece pc : Pieces)
+      for (int s = SQ_A1; s < SQUARE_NB; ++s)
+          keys.psq[pc][s] = rng.rand<Key>();
+
+  keys.side = rng.rand<Key>();
+
+  return keys;
+}();
+
 } // namespace
 
 
@@ -99,17 +114,6 @@ std::ostream& operator<<(std::ostream& os, const Position& pos) {
 }
 
 
-// initializes at startup the arrays used to compute hash keys
-void Position::init() {
-  PRNG rng(1070372);
-
-  for (Piece pc : Pieces)
-      for (Square s = SQ_A1; s < SQUARE_NB; ++s)
-          Zobrist::psq[pc][s] = rng.rand<Key>();
-
-  Zobrist::side = rng.rand<Key>();
-}
-
 // generate unique position identifier
 Key Position::generate_hash_key() {
   uint64_t finalKey = 0;
@@ -118,13 +122,13 @@ Key Position::generate_hash_key() {
   for (Square s = SQ_A1; s < SQUARE_NB; ++s) {
     if (board[s] != OFFBOARD) {
       Piece piece = board[s];
-      if (piece != NO_PIECE) finalKey ^= Zobrist::psq[piece][s];
+      if (piece != NO_PIECE) finalKey ^= Zobrist.psq[piece][s];
     }
   }
   
   
   // hash board state variables
-  if (sideToMove == WHITE) finalKey ^= Zobrist::side;
+  if (sideToMove == WHITE) finalKey ^= Zobrist.side;
   
   return (Key)finalKey;
 }
@@ -272,6 +276,26 @@ Position& Position::set(const string& fenStr, StateInfo* si) {
   // generate hash key
   hashKey = generate_hash_key();
 
+  inCheck =   kingSquare[sideToMove] != SQ_NONE
+           && is_square_attacked(kingSquare[sideToMove], ~sideToMove);
+
+  return *this;
+}
+
+
+/// Position::set() overload copies a position, used to give every search
+/// thread its own root position. The current state is copied into 'si'
+/// without its link to the previous states, which are not needed as the
+/// repetition table is part of the position.
+
+Position& Position::set(const Position& pos, StateInfo* si, Thread* th) {
+
+  std::memcpy(static_cast<void*>(this), &pos, sizeof(Position));
+  *si = *pos.st;
+  si->previous = nullptr;
+  st = si;
+  thisThread = th;
+
   return *this;
 }
 
@@ -286,6 +310,8 @@ string Position::fen() const {
 
 // square attacked by the given side
 bool Position::is_square_attacked(Square s, Color c) {
+  TRACE_SCOPE(IS_SQUARE_ATTACKED);
+
   // by knights
   for (int direction = 0; direction < 4; direction++) {
     Square directionTarget = (Square)(s + DIAGONALS[direction]);
@@ -332,12 +358,14 @@ bool Position::is_square_attacked(Square s, Color c) {
 /// to a StateInfo object. The move is assumed to be pseudo legal.
  
 bool Position::do_move(Move move, StateInfo& newSt) {
+  TRACE_SCOPE(DO_MOVE);
+
   // update plies
   ++searchPly;
   ++gamePly;
       
   // update repetition table
-  repetitionTable[gamePly] = hashKey;
+  repetitionTable[gamePly & (MAX_MOVES - 1)] = hashKey;
   
   // copy current state info
   std::memcpy(&newSt, st, offsetof(StateInfo, hashKey));
@@ -347,6 +375,9 @@ bool Position::do_move(Move move, StateInfo& newSt) {
   // push to stack
   st->hashKey = hashKey;
   st->rule60 = rule60;
+  st->pliesFromNull = pliesFromNull;
+  st->inCheck = inCheck;
+  ++pliesFromNull;
   
   // parse move
   Square sourceSquare = move_source_square(move);
@@ -360,12 +391,12 @@ bool Position::do_move(Move move, StateInfo& newSt) {
   board[sourceSquare] = NO_PIECE;
   
   // hash piece
-  hashKey ^= Zobrist::psq[sourcePiece][sourceSquare];
-  hashKey ^= Zobrist::psq[sourcePiece][targetSquare];
+  hashKey ^= Zobrist.psq[sourcePiece][sourceSquare];
+  hashKey ^= Zobrist.psq[sourcePiece][targetSquare];
   
   if (captureFlag) {
     rule60 = 0;
-    hashKey ^= Zobrist::psq[targetPiece][targetSquare];
+    hashKey ^= Zobrist.psq[targetPiece][targetSquare];
   } else rule60++;
 
   // update king square (note: accessing data fields directly for performance reasons)
@@ -374,13 +405,18 @@ bool Position::do_move(Move move, StateInfo& newSt) {
   
   // switch side to move
   sideToMove = (Color)(sideToMove ^ BLACK);
-  hashKey ^= Zobrist::side;
+  hashKey ^= Zobrist.side;
   
   // undo move if king has been left exposed into a check
   if (is_square_attacked(kingSquare[sideToMove ^ BLACK], sideToMove)) {
     undo_move(move);
     return false;
-  } else return true;
+  }
+
+  // the move is legal, find out whether it gives check
+  inCheck = is_square_attacked(kingSquare[sideToMove], ~sideToMove);
+
+  return true;
 }
 
 
@@ -388,6 +424,8 @@ bool Position::do_move(Move move, StateInfo& newSt) {
 /// be restored to exactly the same state as before the move was made.
 
 void Position::undo_move(Move move) {
+  TRACE_SCOPE(UNDO_MOVE);
+
   // update plies
   --searchPly;
   --gamePly;
@@ -415,8 +453,9 @@ void Position::undo_move(Move move) {
   // restore state variables
   rule60 = st->rule60;
   hashKey = st->hashKey;
-  
-  
+  pliesFromNull = st->pliesFromNull;
+  inCheck = st->inCheck;
+
   // Finally point our state pointer back to the previous state
   st = st->previous;
 }
@@ -426,12 +465,70 @@ void Position::undo_move(Move move) {
 /// the side to move without executing any move on the board.
 
 void Position::do_null_move(StateInfo& newSt) {
-  // avaiod warning
-  if (newSt.hashKey) {}
+  assert(&newSt != st);
+
+  // update plies
+  ++searchPly;
+  ++gamePly;
+
+  // update repetition table
+  repetitionTable[gamePly & (MAX_MOVES - 1)] = hashKey;
+
+  // push to stack
+  newSt.previous = st;
+  st = &newSt;
+  st->hashKey = hashKey;
+  st->rule60 = rule60;
+  st->pliesFromNull = pliesFromNull;
+  st->inCheck = inCheck;
+
+  // a null move counts as a reversible ply, but no position before it can be
+  // repeated after it, so the repetition search stops here
+  ++rule60;
+  pliesFromNull = 0;
+
+  // the side passing is not in check, so neither is the opponent after it
+  assert(!inCheck);
+  inCheck = false;
+
+  // switch side to move
+  sideToMove = (Color)(sideToMove ^ BLACK);
+  hashKey ^= Zobrist.side;
 }
 
 void Position::undo_null_move() {
+  // update plies
+  --searchPly;
+  --gamePly;
+
+  // switch side to move
+  sideToMove = (Color)(sideToMove ^ BLACK);
 
+  // restore state variables
+  rule60 = st->rule60;
+  hashKey = st->hashKey;
+  pliesFromNull = st->pliesFromNull;
+  inCheck = st->inCheck;
+
+  // Finally point our state pointer back to the previous state
+  st = st->previous;
+}
+
+
+/// Position::has_attackers() tells whether the given side still has a rook,
+/// knight or cannon. Without them zugzwang becomes likely and null move
+/// pruning is unsafe.
+
+bool Position::has_attackers(Color c) const {
+  for (Square s = SQ_A1; s < SQUARE_NB; ++s) {
+    Piece pc = board[s];
+    if (   pc != OFFBOARD
+        && PIECE_COLOR[pc] == c
+        && (PIECE_TYPE[pc] == ROOK || PIECE_TYPE[pc] == KNIGHT || PIECE_TYPE[pc] == CANNON))
+      return true;
+  }
+
+  return false;
 }
 
 // reset repetition table
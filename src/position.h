@@ -29,6 +29,8 @@
 
 namespace Stockfish {
 
+class Thread;
+
 /// StateInfo struct stores information needed to restore a Position object to
 /// its previous state when we retract a move. Whenever a move is made on the
 /// board (by calling Position::make_move), a StateInfo object must be passed.
@@ -37,6 +39,8 @@ struct StateInfo {
   // Actually used
   Key hashKey;
   int rule60;
+  int pliesFromNull;
+  bool inCheck;
   StateInfo* previous;
 };
 
@@ -54,14 +58,13 @@ typedef std::unique_ptr<std::deque<StateInfo>> StateListPtr;
 
 class Position {
 public:
-  static void init();
-
   Position() = default;
   Position(const Position&) = delete;
   Position& operator=(const Position&) = delete;
 
   // FEN string input/output
   Position& set(const std::string& fenStr, StateInfo* si);
+  Position& set(const Position& pos, StateInfo* si, Thread* th);
   std::string fen() const; // TODO
   
   // board interface
@@ -94,6 +97,10 @@ public:
   int search_ply() const;
   int game_ply() const;
   int rule60_count() const;
+  int plies_from_null() const;
+  bool has_attackers(Color c) const;
+  bool in_check() const;
+  Thread* this_thread() const;
 
   // state info
   StateInfo* state() const;
@@ -137,11 +144,14 @@ private:
   // board state
   Color sideToMove;
   int rule60;
+  int pliesFromNull;
+  bool inCheck;
   Key hashKey;
   Square kingSquare[2];
   
   // state info pointer
   StateInfo* st;
+  Thread* thisThread;
 };
 
 // print board
@@ -167,10 +177,14 @@ inline Key Position::hash_key() const {
   return hashKey;
 }
 
-// repetition detection
+// repetition detection, repetitionTable[ply] holds the key of the position
+// before the move made at that ply. Only the positions since the last capture
+// or null move (which cannot recur) are looked at.
 inline bool Position::is_repetition() const {
-  for (int i = 0; i < MAX_MOVES; ++i) {
-    if (repetitionTable[i] == hashKey)
+  int end = std::min(rule60, pliesFromNull);
+
+  for (int i = 4; i <= end; i += 2) {
+    if (repetitionTable[(gamePly - i + 1) & (MAX_MOVES - 1)] == hashKey)
       return true;
   }
   
@@ -192,6 +206,22 @@ inline int Position::rule60_count() const {
   return rule60;
 }
 
+// get the number of plies since the last null move
+inline int Position::plies_from_null() const {
+  return pliesFromNull;
+}
+
+// whether the side to move is in check, found by do_move() along with the
+// legality of the move that led here
+inline bool Position::in_check() const {
+  return inCheck;
+}
+
+// get the search thread owning the position, nullptr outside the search
+inline Thread* Position::this_thread() const {
+  return thisThread;
+}
+
 // set piece on the given board square
 inline void Position::put_piece(Piece pc, Square s) {
   board[s] = pc;
@@ -17,18 +17,25 @@
 */
 
 #include <algorithm>
+#include <array>
 #include <cassert>
 #include <cmath>
 #include <cstring>   // For std::memset
+#include <iomanip>
 #include <iostream>
 #include <sstream>
 
+#include "cluster.h"
 #include "evaluate.h"
 #include "misc.h"
 #include "movegen.h"
+#include "movepick.h"
 #include "position.h"
 #include "search.h"
+#include "thread.h"
 #include "timeman.h"
+#include "treedump.h"
+#include "tt.h"
 #include "uci.h"
 
 namespace Stockfish {
@@ -44,18 +51,116 @@ using Eval::evaluate;
 using namespace Search;
 
 namespace {
-  // temp
-  Move globalBestMove = MOVE_NONE;
+
+  // Different node types, used as a template parameter
+  enum NodeType { NonPV, PV, Root };
+
+  // Reductions lookup table, initialized at startup
+  int Reductions[MAX_MOVES]; // [depth or moveNumber]
+
+  Depth reduction(bool i, Depth d, int mn) {
+    int r = Reductions[std::min(d, MAX_MOVES - 1)] * Reductions[std::min(mn, MAX_MOVES - 1)];
+    return (r + 534) / 1024 + (!i && r > 904);
+  }
+
+  // Forward pruning margins, read from the UCI options at the start of each
+  // search so that they can be tuned with setoption.
+  int RfpMargin, FutilityBase, FutilityMargin, RazorMargin, LmpBase;
+
+  // Move count threshold of late move pruning
+  int futility_move_count(bool improving, Depth depth) {
+    return (LmpBase + depth * depth) / (2 - improving);
+  }
+
+  // History and stats update bonus, based on depth
+  int stat_bonus(Depth d) {
+    return d > 14 ? 73 : 6 * d * d + 229 * d - 215;
+  }
+
+  // ABDADA, when selected by the "SMP Mode" option: a move whose position is
+  // being searched by another thread is deferred until all the other moves of
+  // the node have been searched, so that the threads spread over the siblings
+  // instead of searching the same subtree. The first move of a node is never
+  // deferred, the younger brothers wait for it as in YBWC. The positions being
+  // searched are marked in a small table of breadcrumbs, one per position.
+  bool Abdada;
+  constexpr Depth AbdadaDepth = 3;
+
+  struct Breadcrumb {
+    std::atomic<Thread*> thread;
+    std::atomic<Key> key;
+  };
+  std::array<Breadcrumb, 4096> breadcrumbs;
+
+  // ThreadHolding marks the position as being searched by the thread, if the
+  // breadcrumb is free, and releases it when going out of scope. marked()
+  // tells whether another thread holds it for the same position.
+  struct ThreadHolding {
+    explicit ThreadHolding(Thread* thisThread, Key posKey, bool active) {
+       location = active ? &breadcrumbs[posKey & (breadcrumbs.size() - 1)] : nullptr;
+       otherThread = false;
+       owning = false;
+       if (location)
+       {
+          // See if another already marked this location, if not, mark it ourselves
+          Thread* tmp = location->thread.load(std::memory_order_relaxed);
+          if (tmp == nullptr)
+          {
+              location->thread.store(thisThread, std::memory_order_relaxed);
+              location->key.store(posKey, std::memory_order_relaxed);
+              owning = true;
+          }
+          else if (   tmp != thisThread
+                   && location->key.load(std::memory_order_relaxed) == posKey)
+              otherThread = true;
+       }
+    }
+
+    ~ThreadHolding() {
+       if (owning) // Free the marked location
+           location->thread.store(nullptr, std::memory_order_relaxed);
+    }
+
+    bool marked() { return otherThread; }
+
+    private:
+    Breadcrumb* location;
+    bool otherThread, owning;
+  };
+
+  // A thread stops on the common stop flag or, in deterministic mode, once
+  // it has used up its own share of the node limit.
+  bool stopped(const Thread* th) {
+    return   Threads.stop.load(std::memory_order_relaxed)
+          || (th->nodeBudget && th->nodes.load(std::memory_order_relaxed) >= th->nodeBudget);
+  }
+
   // define alpha beta search
-  Value search(Position& pos, Value alpha, Value beta, Depth depth);
-  
+  template <NodeType nodeType>
+  Value search(Position& pos, Stack* ss, Value alpha, Value beta, Depth depth);
+
   // define quiescence
+  template <NodeType nodeType>
+  Value qsearch(Position& pos, Stack* ss, Value alpha, Value beta);
+
+  // define mate search, see MainThread::search_mate()
+  template <bool Attacker>
+  Value mate(Position& pos, Stack* ss, Value alpha, Value beta, Depth depth);
   
+  // Leaf nodes counted by the last perft run
+  uint64_t nodes_cnt = 0;
+
+  Value value_to_tt(Value v, int ply);
+  Value value_from_tt(Value v, int ply);
+  void update_pv(Move* pv, Move move, Move* childPv);
+  void update_continuation_histories(Stack* ss, Piece pc, Square to, int bonus);
+  void update_quiet_stats(const Position& pos, Stack* ss, Move move, int bonus);
+  void update_all_stats(const Position& pos, Stack* ss, Move bestMove, Depth depth,
+                        Move* quietsSearched, int quietCount, Move* capturesSearched, int captureCount);
+
   // perft() is our utility to verify move generation. All the leaf nodes up
   // to the given depth are generated and counted, and the sum is returned.
 
-  uint64_t nodes_cnt = 0;
-
   // local perft driver
   void perftDriver(Position& pos, Depth depth) {
     StateInfo st;
@@ -113,6 +218,8 @@ void Search::perftTest(Position& pos, Depth depth) {
 
 void Search::init() {
 
+  for (int i = 1; i < MAX_MOVES; ++i)
+      Reductions[i] = int(21.9 * std::log(i));
 }
 
 
@@ -120,77 +227,1386 @@ void Search::init() {
 
 void Search::clear() {
 
+  Threads.main()->wait_for_search_finished();
+
+  Time.availableNodes = 0;
+  TT.clear();
+  Threads.clear();
 }
 
-/// Main search is started when the program receives the UCI 'go'
+/// Search::nodes_searched() returns the number of nodes visited by the last
+/// search or perft run, summed over all the threads.
+
+uint64_t Search::nodes_searched() {
+  return Threads.nodes_searched();
+}
+
+
+/// Search::print_stats() outputs, for the last search of the main thread, the
+/// number of nodes, beta cutoffs and cutoffs on the first move at each ply,
+/// together with the mean number of moves searched before a cutoff and the
+/// effective branching factor. With 'json' set the same data is written as a
+/// single JSON object.
+
+void Search::print_stats(bool json) {
+
+  const TreeStats& ts = Threads.main()->treeStats;
+  int maxPly = 0;
+  uint64_t total = 0;
+
+  for (int ply = 0; ply < MAX_PLY; ++ply)
+      if (ts.nodes[ply])
+          maxPly = ply, total += ts.nodes[ply];
+
+  std::stringstream ss;
+  ss << std::fixed << std::setprecision(2);
+
+  if (json)
+  {
+      ss << "{\"nodes\":" << total
+         << ",\"illegalMoves\":" << ts.illegalMoves
+         << ",\"qsearchNodes\":" << ts.qsearchNodes
+         << ",\"plies\":[";
+
+      for (int ply = 0; ply <= maxPly && total; ++ply)
+          ss << (ply ? "," : "")
+             << "{\"ply\":" << ply
+             << ",\"nodes\":" << ts.nodes[ply]
+             << ",\"cutoffs\":" << ts.cutoffs[ply]
+             << ",\"firstMoveCutoffs\":" << ts.firstMoveCutoffs[ply]
+             << ",\"movesBeforeCutoff\":"
+             << (ts.cutoffs[ply] ? double(ts.movesBeforeCutoff[ply]) / ts.cutoffs[ply] : 0.0)
+             << "}";
+
+      ss << "]}";
+  }
+  else
+  {
+      ss << "  ply        nodes      cutoffs    first %  moves/cut    bf\n";
+
+      for (int ply = 0; ply <= maxPly && total; ++ply)
+          ss << std::setw(5)  << ply
+             << std::setw(13) << ts.nodes[ply]
+             << std::setw(13) << ts.cutoffs[ply]
+             << std::setw(11) << (ts.cutoffs[ply] ? 100.0 * ts.firstMoveCutoffs[ply] / ts.cutoffs[ply] : 0.0)
+             << std::setw(11) << (ts.cutoffs[ply] ? double(ts.movesBeforeCutoff[ply]) / ts.cutoffs[ply] : 0.0)
+             << std::setw(8)  << (ply < maxPly ? double(ts.nodes[ply + 1]) / ts.nodes[ply] : 0.0)
+             << "\n";
+
+      ss << "\nNodes          : " << total
+         << "\nIllegal moves  : " << ts.illegalMoves
+         << "\nQsearch nodes  : " << ts.qsearchNodes << " ("
+         << (total ? 100.0 * ts.qsearchNodes / total : 0.0) << "%)";
+  }
+
+  sync_cout << ss.str() << sync_endl;
+}
+
+
+/// MainThread::search() is started when the program receives the UCI 'go'
 /// command. It searches from the root position and outputs the "bestmove".
 
-void Search::sync_search(Position& pos, LimitsType& limits) {
-  // do perft and return
-  if ((Depth)limits.perft)
+void MainThread::search() {
+
+  PerfCounters perf;
+
+  if (Limits.perft)
   {
-      Search::perftTest(pos, limits.perft);
+      perf.start();
+      Search::perftTest(rootPos, Limits.perft);
+      perf.stop();
+      nodes = nodes_cnt;
+      perf.print("Perft counters", nodes_cnt);
       return;
   }
-  
-  // search position
-  search(pos, -VALUE_INFINITE, VALUE_INFINITE, limits.depth);
-  std::cout << "bestmove " << UCI::move(globalBestMove) << "\n";
+
+  Color us = rootPos.side_to_move();
+  Time.init(Limits, us, rootPos.game_ply());
+  TT.new_search();
+
+  // Read before the helpers start, so that they see the same margins
+  RfpMargin      = int(Options["RFP Margin"]);
+  FutilityBase   = int(Options["Futility Base"]);
+  FutilityMargin = int(Options["Futility Margin"]);
+  RazorMargin    = int(Options["Razor Margin"]);
+  LmpBase        = int(Options["LMP Base"]);
+  Abdada         = Options["SMP Mode"] == "ABDADA" && Threads.size() > 1 && !Threads.deterministic;
+
+  perf.start();
+  printedDepth = 0;
+
+  if (rootMoves.empty())
+  {
+      rootMoves.emplace_back(MOVE_NONE);
+      sync_cout << "info depth 0 score " << UCI::value(mated_in(0)) << sync_endl;
+  }
+  else if (Limits.mate)
+      search_mate();             // main thread alone
+  else
+  {
+      Threads.start_searching(); // start non-main threads
+      Thread::search();          // main thread start searching
+
+      // In deterministic mode the helpers stop on their own limits
+      if (Threads.deterministic)
+          Threads.wait_for_search_finished();
+  }
+
+  // The cluster workers have our depth and node limits, but not the clock
+  if (Threads.split && !Threads.deterministic)
+      Cluster::finish(   Limits.use_time_management() || Limits.movetime
+                      || (!Limits.depth && !Limits.nodes));
+
+  // When we reach the maximum depth, we can arrive here without a raise of
+  // Threads.stop. However, if we are pondering or in an infinite search,
+  // the UCI protocol states that we shouldn't print the best move before the
+  // GUI sends a "stop" or "ponderhit" command. We therefore simply wait here
+  // until the GUI sends one of those commands.
+
+  while (!Threads.stop && (ponder || Limits.infinite))
+  {} // Busy wait for a stop or a ponder reset
+
+  // Stop the threads if not already stopped (also raise the stop if
+  // "ponderhit" just reset Threads.ponder).
+  Threads.stop = true;
+
+  // Wait until all threads have finished
+  Threads.wait_for_search_finished();
+
+  perf.stop();
+
+  if (dumpDepth)
+      TreeDump::flush();
+
+  perf.print("Search counters", Threads.nodes_searched());
+
+  // When playing in 'nodes as time' mode, subtract the searched nodes from
+  // the available ones before exiting.
+  if (Limits.npmsec)
+      Time.availableNodes += Limits.inc[us] - Threads.nodes_searched();
+
+  Thread* bestThread = this;
+
+  if (Threads.split && !Limits.mate && rootMoves[0].pv[0] != MOVE_NONE)
+  {
+      Depth depth = gathered_depth();
+
+      print_gathered(depth);
+      rootMoves = gather(depth);
+      completedDepth = depth;
+
+      // No depth completed by all the parts: print the lines as they were left
+      if (!depth)
+          sync_cout << UCI::pv(rootPos, 1, -VALUE_INFINITE, VALUE_INFINITE) << sync_endl;
+  }
+
+  else if (   int(Options["MultiPV"]) == 1
+           && !Limits.depth
+           && !Limits.mate
+           && rootMoves[0].pv[0] != MOVE_NONE)
+      bestThread = Threads.get_best_thread();
+
+  // Send again PV info if we have a new best thread
+  if (bestThread != this)
+      sync_cout << UCI::pv(bestThread->rootPos, bestThread->completedDepth, -VALUE_INFINITE, VALUE_INFINITE) << sync_endl;
+
+  Move bestMove = bestThread->rootMoves[0].pv[0];
+  Move ponderMove = bestThread->rootMoves[0].pv.size() > 1 ? bestThread->rootMoves[0].pv[1] : MOVE_NONE;
+
+  // In a timed game, search the likely replies until the opponent moves. The
+  // flags are raised before "bestmove" is sent, so that the next command
+  // from the GUI always finds the speculative search running and stops it.
+  bool speculative =   Options["Speculative Replies"]
+                    && Limits.use_time_management()
+                    && bestMove != MOVE_NONE;
+  if (speculative)
+  {
+      Threads.stop = false;
+      Threads.speculating = true;
+  }
+
+  sync_cout << "bestmove " << UCI::move(bestMove);
+
+  if (ponderMove)
+      std::cout << " ponder " << UCI::move(ponderMove);
+
+  std::cout << sync_endl;
+
+  if (speculative)
+      speculate(bestMove, ponderMove);
 }
 
+
+/// MainThread::gathered_depth() returns the deepest iteration completed by all
+/// the parts of a search where the root moves were split between the threads
+/// (deterministic mode) or the cluster workers, 0 if one of them did not
+/// complete any.
+
+Depth MainThread::gathered_depth() {
+
+  Depth depth = Cluster::depth();
+
+  for (Thread* th : Threads)
+      if ((Threads.deterministic || th == this) && !th->rootMoves.empty())
+          depth = std::min(depth, th->completedDepth);
+
+  return depth;
+}
+
+
+/// MainThread::gather() collects the best lines of all the parts of a split
+/// search at the given depth, which they all completed, or as they were left
+/// for depth 0. They are returned sorted, best first.
+
+RootMoves MainThread::gather(Depth depth) {
+
+  RootMoves best;
+
+  for (Thread* th : Threads)
+      if ((Threads.deterministic || th == this) && !th->rootMoves.empty())
+          best.push_back(depth ? th->iterationBest[depth - 1] : th->rootMoves[0]);
+
+  Cluster::results(rootPos, depth, best);
+
+  std::stable_sort(best.begin(), best.end());
+
+  return best;
+}
+
+
+/// MainThread::print_gathered() prints the merged line of every depth of a
+/// split search up to 'depth' not printed yet, so that each depth is printed
+/// once, in order.
+
+void MainThread::print_gathered(Depth depth) {
+
+  for ( ; printedDepth < depth; ++printedDepth)
+  {
+      RootMoves merged = gather(printedDepth + 1);
+
+      std::swap(rootMoves, merged);
+      sync_cout << UCI::pv(rootPos, printedDepth + 1, -VALUE_INFINITE, VALUE_INFINITE) << sync_endl;
+      std::swap(rootMoves, merged);
+  }
+}
+
+
+/// MainThread::speculate() is called after "bestmove" has been sent, when the
+/// "Speculative Replies" option is set. Where pondering bets on the expected
+/// reply only, here the threads are spread over the most likely replies: the
+/// expected one, then the others by the score the last search left in the
+/// hash table, then by move ordering. Each thread searches the position after
+/// its reply until the next command from the GUI, the best line of every
+/// position being kept in 'speculations' for the next search to start from.
+/// The hash table entries written in the meantime are reused as well.
+
+void MainThread::speculate(Move best, Move expected) {
+
+  StateInfo st[3];
+  Position pos;
+
+  pos.set(rootPos, &st[0], this);
+  pos.do_move(best, st[1]);
+  pos.reset_search_ply();
+
+  // Rank the legal replies. The hash table holds their values from our point
+  // of view, as it is our turn after them, so the lower the better for them.
+  std::vector<std::pair<int, Move>> replies;
+  const PieceToHistory* contHist[] = { &continuationHistory[NO_PIECE][0], &continuationHistory[NO_PIECE][0] };
+  const Move noKillers[2] = { MOVE_NONE, MOVE_NONE };
+  MovePicker mp(pos, MOVE_NONE, &mainHistory, &captureHistory, contHist, MOVE_NONE, noKillers);
+  Move m;
+  bool ttHit;
+
+  while ((m = mp.next_move()) != MOVE_NONE)
+      if (pos.do_move(m, st[2]))
+      {
+          TTEntry* tte = TT.probe(pos.hash_key(), ttHit);
+          int rank =  m == expected                       ? int(VALUE_INFINITE)
+                    : ttHit && tte->value() != VALUE_NONE ? -tte->value()
+                                                          : -VALUE_INFINITE;
+          replies.emplace_back(rank, m);
+          pos.undo_move(m);
+      }
+
+  std::stable_sort(replies.begin(), replies.end(), [](const auto& a, const auto& b) {
+      return a.first > b.first;
+  });
+
+  size_t n = std::min(size_t(Options["Speculative Replies"]), replies.size());
+
+  speculations.clear();
+
+  if (!n) // We have mated the opponent
+  {
+      Threads.speculating = false;
+      return;
+  }
+
+  // Threads beyond the number of replies share them, lazy SMP style, over the
+  // whole hash table and without node budgets.
+  Threads.deterministic = Threads.split = false;
+  TT.partition(1);
+
+  for (size_t i = 0; i < Threads.size(); ++i)
+  {
+      Thread* th = Threads[i];
+      Move reply = replies[i % n].second;
+
+      pos.do_move(reply, st[2]);
+      th->rootPos.set(pos, &th->rootState, th);
+      th->rootPos.reset_search_ply();
+      pos.undo_move(reply);
+
+      th->rootMoves.clear();
+      for (const auto& rm : MoveList<PSEUDO_LEGAL>(th->rootPos))
+          if (th->rootPos.do_move(rm, st[2]))
+          {
+              th->rootPos.undo_move(rm);
+              th->rootMoves.emplace_back(rm);
+          }
+
+      th->nodes = th->nmpMinPly = 0;
+      th->rootDepth = th->completedDepth = 0;
+      th->nodeBudget = 0;
+      th->ttPart = 0;
+      th->iterationBest.clear();
+  }
+
+  // Search without limits until stopped by the next command
+  Limits = LimitsType();
+  Limits.startTime = now();
+
+  Threads.start_searching();
+  Thread::search();
+
+  while (!Threads.stop)
+  {} // Busy wait for the next command
+
+  Threads.wait_for_search_finished();
+
+  // Keep the deepest result for every position searched
+  for (Thread* th : Threads)
+  {
+      if (!th->completedDepth || th->rootMoves.empty())
+          continue;
+
+      auto it = speculations.find(th->rootPos.hash_key());
+
+      if (it == speculations.end() || it->second.depth < th->completedDepth)
+          speculations.insert_or_assign(th->rootPos.hash_key(),
+                                        Speculation{ th->completedDepth, th->rootMoves[0] });
+  }
+
+  Threads.speculating = false;
+}
+
+
+/// MainThread::search_mate() answers "go mate N". Instead of the normal search
+/// it looks for a forced mate in at most N moves, trying only checking moves
+/// for the side to move and all the replies for the defender. The depth grows
+/// by one move at a time, so the first mate proven is the shortest one, and
+/// the search stops there.
+
+void MainThread::search_mate() {
+
+  Stack stack[MAX_PLY+10], *ss = stack+7;
+  Move pv[MAX_PLY+1];
+
+  std::memset(stack, 0, sizeof(stack));
+  for (int i = 7; i > 0; i--)
+      (ss-i)->continuationHistory = &continuationHistory[NO_PIECE][0]; // Use as a sentinel
+
+  for (int i = 0; i <= MAX_PLY + 2; ++i)
+      (ss+i)->ply = i;
+
+  ss->pv = pv;
+
+  Depth maxDepth = std::min(2 * Limits.mate - 1, MAX_PLY - 1);
+
+  for (rootDepth = 1; rootDepth <= maxDepth; rootDepth += 2)
+  {
+      selDepth = rootDepth;
+
+      // Any value above zero is a mate, so the window starts there
+      Value v = mate<true>(rootPos, ss, VALUE_ZERO, VALUE_INFINITE, rootDepth);
+
+      if (stopped(this))
+          break;
+
+      completedDepth = rootDepth;
+
+      if (v >= VALUE_MATE_IN_MAX_PLY)
+      {
+          auto rm = std::find(rootMoves.begin(), rootMoves.end(), pv[0]);
+          assert(rm != rootMoves.end());
+
+          rm->score = v;
+          rm->selDepth = selDepth;
+          rm->pv.assign(pv, std::find(pv, pv + MAX_PLY, MOVE_NONE));
+          std::rotate(rootMoves.begin(), rm, rm + 1);
+
+          sync_cout << UCI::pv(rootPos, rootDepth, -VALUE_INFINITE, VALUE_INFINITE) << sync_endl;
+          return;
+      }
+
+      sync_cout << "info depth " << rootDepth
+                << " nodes " << Threads.nodes_searched()
+                << " time "  << now() - Limits.startTime << sync_endl;
+  }
+
+  sync_cout << "info string no mate in " << Limits.mate << " found" << sync_endl;
+}
+
+
+/// Thread::search() is the main iterative deepening loop. It calls search()
+/// repeatedly with increasing depth until the allocated thinking time has been
+/// consumed, the user stops the search, or the maximum search depth is reached.
+
+void Thread::search() {
+
+  // To allow access to (ss-7) up to (ss+2), the stack must be oversized.
+  // The former is needed to allow update_continuation_histories(ss-1, ...),
+  // which accesses its argument at ss-6, also near the root.
+  // The latter is needed for statScore and killer initialization.
+  Stack stack[MAX_PLY+10], *ss = stack+7;
+  Move pv[MAX_PLY+1];
+  Value bestValue, alpha, beta, delta;
+  MainThread* mainThread = (this == Threads.main() ? Threads.main() : nullptr);
+
+  std::memset(ss-7, 0, 10 * sizeof(Stack));
+  for (int i = 7; i > 0; i--)
+      (ss-i)->continuationHistory = &continuationHistory[NO_PIECE][0]; // Use as a sentinel
+
+  for (int i = 0; i <= MAX_PLY + 2; ++i)
+      (ss+i)->ply = i;
+
+  ss->pv = pv;
+
+  std::memset(&treeStats, 0, sizeof(TreeStats));
+  dumpDepth = mainThread && !Threads.speculating ? TreeDump::depth() : 0;
+
+  size_t multiPV = std::min(size_t(Options["MultiPV"]), rootMoves.size());
+
+  // Iterative deepening loop until requested to stop or the target depth is reached
+  while (   ++rootDepth < MAX_PLY
+         && !stopped(this)
+         && !(Limits.depth && (mainThread || Threads.deterministic) && rootDepth > Limits.depth))
+  {
+      // Save the last iteration's scores before the first PV line is searched
+      for (RootMove& rm : rootMoves)
+          rm.previousScore = rm.score;
+
+      // MultiPV loop. We perform a full root search for each PV line
+      for (pvIdx = 0; pvIdx < multiPV && !stopped(this); ++pvIdx)
+      {
+          selDepth = 0;
+
+          // Reset aspiration window starting size
+          delta = Value(12);
+          alpha = -VALUE_INFINITE;
+          beta = VALUE_INFINITE;
+
+          if (rootDepth >= 4)
+          {
+              Value prev = rootMoves[pvIdx].previousScore;
+              alpha = std::max(prev - delta, -VALUE_INFINITE);
+              beta  = std::min(prev + delta,  VALUE_INFINITE);
+          }
+
+          // Start with a small aspiration window and, in the case of a fail
+          // high/low, re-search with a bigger window until we don't fail
+          // high/low anymore.
+          while (true)
+          {
+              uint64_t nodesBefore = nodes.load(std::memory_order_relaxed);
+
+              bestValue = Stockfish::search<Root>(rootPos, ss, alpha, beta, rootDepth);
+
+              if (dumpDepth)
+                  TreeDump::write(0, MOVE_NONE, alpha, beta, bestValue,
+                                  nodes.load(std::memory_order_relaxed) - nodesBefore + 1);
+
+              // Bring the best move to the front. It is critical that sorting
+              // is done with a stable algorithm because all the values but the
+              // first and eventually the new best one are set to -VALUE_INFINITE
+              // and we want to keep the same order for all the moves except the
+              // new PV that goes to the front.
+              std::stable_sort(rootMoves.begin() + pvIdx, rootMoves.end());
+
+              // If search has been stopped, we break immediately. Sorting is
+              // safe because RootMoves is still valid, although it refers to
+              // the previous iteration.
+              if (stopped(this))
+                  break;
+
+              // In case of failing low/high increase aspiration window and
+              // re-search, otherwise exit the loop.
+              if (bestValue <= alpha)
+              {
+                  beta = (alpha + beta) / 2;
+                  alpha = std::max(bestValue - delta, -VALUE_INFINITE);
+
+                  if (mainThread)
+                      mainThread->stopOnPonderhit = false;
+              }
+              else if (bestValue >= beta)
+                  beta = std::min(bestValue + delta, VALUE_INFINITE);
+
+              else
+                  break;
+
+              delta += delta / 4 + 5;
+
+              assert(alpha >= -VALUE_INFINITE && beta <= VALUE_INFINITE);
+          }
+
+          // Sort the PV lines searched so far
+          std::stable_sort(rootMoves.begin(), rootMoves.begin() + pvIdx + 1);
+      }
+
+      if (!stopped(this))
+      {
+          completedDepth = rootDepth;
+
+          if (Threads.split && !Threads.speculating && !rootMoves.empty())
+              iterationBest.push_back(rootMoves[0]);
+      }
+
+      if (!mainThread || Threads.speculating)
+          continue;
+
+      // When the root moves are split between the threads the result is
+      // printed once they are all done. When they are split with cluster
+      // workers, the merged line is printed every time all of them have
+      // completed a new depth.
+      if (!Threads.split)
+          sync_cout << UCI::pv(rootPos, rootDepth, -VALUE_INFINITE, VALUE_INFINITE) << sync_endl;
+
+      else if (!Threads.deterministic)
+          mainThread->print_gathered(mainThread->gathered_depth());
+
+      // Do we have time for the next iteration? Once the optimum time is
+      // used up the next iteration would most likely not finish, so stop.
+      if (   Limits.use_time_management()
+          && !Threads.stop
+          && !mainThread->stopOnPonderhit
+          && Time.elapsed() > Time.optimum())
+      {
+          // If we are allowed to ponder do not stop the search now but
+          // keep pondering until the GUI sends "ponderhit" or "stop".
+          if (mainThread->ponder)
+              mainThread->stopOnPonderhit = true;
+          else
+              Threads.stop = true;
+      }
+  }
+}
+
+
 namespace {
 
   // search() is the main search function for both PV and non-PV nodes
-  Value search(Position& pos, Value alpha, Value beta, Depth depth) {
-    Move bestMove;
-    Value bestValue, value; 
+  template <NodeType nodeType>
+  Value search(Position& pos, Stack* ss, Value alpha, Value beta, Depth depth) {
+    TRACE_SCOPE(SEARCH);
+
+    constexpr bool PvNode = nodeType != NonPV;
+    constexpr bool rootNode = nodeType == Root;
+
+    assert(-VALUE_INFINITE <= alpha && alpha < beta && beta <= VALUE_INFINITE);
+    assert(PvNode || (alpha == beta - 1));
+
+    Move pv[MAX_PLY+1], move, ttMove, bestMove;
+    Value bestValue, value, ttValue;
     StateInfo st;
-    
+    TTEntry* tte;
+    Key posKey;
+    bool ttHit, improving;
+    int ply = ss->ply;
+    int moveCount = 0;
+
+    // Dive into quiescence search when the depth reaches zero
+    if (depth <= 0)
+        return qsearch<PvNode ? PV : NonPV>(pos, ss, alpha, beta);
+
+    // Initialize node
+    Thread* thisThread = pos.this_thread();
+    Color us = pos.side_to_move();
     bestValue = -VALUE_INFINITE;
     bestMove = MOVE_NONE;
-    
-    // evaluate leaf nodes
-    if( depth == 0 ) return evaluate(pos);//quiesce( alpha, beta );
-    
-    // loop over moves
-    for (const auto& move : MoveList<PSEUDO_LEGAL>(pos))
+
+    // Check for the available remaining time
+    if (thisThread == Threads.main())
+        static_cast<MainThread*>(thisThread)->check_time();
+
+    ++thisThread->treeStats.nodes[std::min(ply, MAX_PLY - 1)];
+
+    // Used to send selDepth info to GUI (selDepth counts from 1, ply from 0)
+    if (PvNode && thisThread->selDepth < ply + 1)
+        thisThread->selDepth = ply + 1;
+
+    if (stopped(thisThread))
+        return VALUE_ZERO;
+
+    if (ply >= MAX_PLY)
+        return evaluate(pos);
+
+    ss->inCheck = pos.in_check();
+    ss->moveCount = 0;
+    (ss+2)->killers[0] = (ss+2)->killers[1] = MOVE_NONE;
+
+    // Transposition table lookup. At the root the hash move is the best move
+    // of the previous iteration.
+    posKey = pos.hash_key();
+    tte = TT.probe(posKey, ttHit, thisThread->ttPart);
+    ttValue = ttHit ? value_from_tt(tte->value(), ply) : VALUE_NONE;
+    ttMove =  rootNode ? thisThread->rootMoves[thisThread->pvIdx].pv[0]
+            : ttHit    ? tte->move() : MOVE_NONE;
+
+    // At non-PV nodes we check for an early TT cutoff
+    if (  !PvNode
+        && ttHit
+        && tte->depth() >= depth
+        && ttValue != VALUE_NONE // Possible in case of TT access race
+        && (ttValue >= beta ? (tte->bound() & BOUND_LOWER)
+                            : (tte->bound() & BOUND_UPPER)))
+        return ttValue;
+
+    // Static evaluation of the position, computed once per node and kept on
+    // the stack for pruning decisions here and at deeper plies.
+    if (ss->inCheck)
+    {
+        ss->staticEval = VALUE_NONE;
+        improving = false;
+    }
+    else
     {
+        if (ttHit && tte->eval() != VALUE_NONE)
+            ss->staticEval = tte->eval();
+        else
+        {
+            ss->staticEval = evaluate(pos);
+
+            // Save static evaluation into transposition table
+            tte->save(posKey, VALUE_NONE, PvNode, BOUND_NONE, DEPTH_NONE, MOVE_NONE, ss->staticEval);
+        }
+
+        // Set up the improving flag, true when the static evaluation is better
+        // than two plies ago (or four, when we were in check two plies ago).
+        improving =  (ss-2)->staticEval == VALUE_NONE ? ss->staticEval > (ss-4)->staticEval
+                                                         || (ss-4)->staticEval == VALUE_NONE
+                                                      : ss->staticEval > (ss-2)->staticEval;
+    }
+
+    // Razoring: when the static eval is far below alpha, drop into qsearch
+    // and trust a fail low there.
+    if (   !PvNode
+        && !ss->inCheck
+        && depth <= 3
+        && ss->staticEval + RazorMargin * depth <= alpha)
+    {
+        value = qsearch<NonPV>(pos, ss, alpha, alpha + 1);
+        if (value <= alpha)
+            return value;
+    }
+
+    // Reverse futility pruning: child node, the static eval is well above
+    // beta even after giving back a margin that grows with depth.
+    if (   !PvNode
+        && !ss->inCheck
+        && depth < 7
+        && ss->staticEval - RfpMargin * (depth - improving) >= beta
+        && ss->staticEval < VALUE_KNOWN_WIN)
+        return beta;
+
+    // Null move search with verification search. Skipped right after another
+    // null move, when the side to move is left without rooks, knights and
+    // cannons (zugzwang becomes possible) and when in check, because passing
+    // would let the opponent capture the king.
+    if (   !PvNode
+        && depth >= 2
+        && !ss->inCheck
+        && (ss-1)->currentMove != MOVE_NULL
+        && ss->staticEval >= beta
+        && (ply >= thisThread->nmpMinPly || us != thisThread->nmpColor)
+        && pos.has_attackers(us))
+    {
+        // Reduction grows with depth and with how far eval is above beta
+        Depth R = 3 + depth / 4 + std::min(int(ss->staticEval - beta) / 100, 3);
+
+        ss->currentMove = MOVE_NULL;
+        ss->continuationHistory = &thisThread->continuationHistory[NO_PIECE][0];
+
+        uint64_t nodesBefore = thisThread->nodes.load(std::memory_order_relaxed);
+
+        pos.do_null_move(st);
+        Value nullValue = -search<NonPV>(pos, ss+1, -beta, -beta + 1, depth - R);
+        pos.undo_null_move();
+
+        // dump the null move node too, its children are already in the dump
+        if (ply < thisThread->dumpDepth)
+            TreeDump::write(ply + 1, MOVE_NULL, -beta, -beta + 1, -nullValue,
+                            thisThread->nodes.load(std::memory_order_relaxed) - nodesBefore);
+
+        if (nullValue >= beta)
+        {
+            if (thisThread->nmpMinPly || depth < 10)
+                return beta;
+
+            // Do verification search at high depths, with null move pruning
+            // disabled for us until ply exceeds nmpMinPly.
+            thisThread->nmpMinPly = ply + 3 * (depth - R) / 4;
+            thisThread->nmpColor = us;
+
+            Value v = search<NonPV>(pos, ss, beta - 1, beta, depth - R);
+
+            thisThread->nmpMinPly = 0;
+
+            if (v >= beta)
+                return beta;
+        }
+    }
+
+    // The reduced searches above may have reached a limit
+    if (stopped(thisThread))
+        return VALUE_ZERO;
+
+    Move prevMove = (ss-1)->currentMove;
+    Move counterMove = thisThread->counterMoves[move_source_piece(prevMove)][move_target_square(prevMove)];
+    const PieceToHistory* contHist[] = { (ss-1)->continuationHistory, (ss-2)->continuationHistory };
+
+    MovePicker mp(pos, ttMove, &thisThread->mainHistory, &thisThread->captureHistory,
+                  contHist, counterMove, ss->killers);
+    Move quietsSearched[64], capturesSearched[32], deferred[MAX_MOVES];
+    int quietCount = 0, captureCount = 0, deferredCount = 0, deferredIdx = 0;
+
+    // loop over moves, then over the moves deferred by ABDADA
+    while (   (move = mp.next_move()) != MOVE_NONE
+           || (deferredIdx < deferredCount && (move = deferred[deferredIdx++])))
+    {
+      // At root obey the "searchmoves" option and skip moves not listed in Root
+      // Move List. In MultiPV mode we also skip PV moves that have been already
+      // searched.
+      if (rootNode && !std::count(thisThread->rootMoves.begin() + thisThread->pvIdx,
+                                  thisThread->rootMoves.end(), move))
+          continue;
+
+      bool capture = move_capture_flag(move);
+      Piece movedPiece = move_source_piece(move);
+      Square to = move_target_square(move);
+
       // do move
-      if (pos.do_move(move, st) == false) continue;
-      
-      // recursive negamax call
-      value = -search(pos, -beta, -alpha, depth - 1);
-      
+      if (pos.do_move(move, st) == false) {
+        ++thisThread->treeStats.illegalMoves;
+        continue;
+      }
+
+      ss->moveCount = ++moveCount;
+
+      bool givesCheck = pos.in_check();
+
+      // Pruning at shallow depth, once a move has been searched. Moves are
+      // made first since that is how their legality and checks are known.
+      if (   !PvNode
+          && !ss->inCheck
+          && !capture
+          && !givesCheck
+          && bestValue > VALUE_MATED_IN_MAX_PLY)
+      {
+          // Late move pruning: skip quiet moves after a move count threshold
+          bool prune = moveCount >= futility_move_count(improving, depth);
+
+          // Futility pruning: the static eval plus a margin growing with the
+          // expected depth cannot raise alpha.
+          int lmrDepth = std::max(depth - 1 - reduction(improving, depth, moveCount), 0);
+
+          prune |=   lmrDepth < 7
+                  && ss->staticEval + FutilityBase + FutilityMargin * lmrDepth <= alpha;
+
+          if (prune)
+          {
+              pos.undo_move(move);
+              continue;
+          }
+      }
+
+      // ABDADA: defer the move if another thread is searching it, except on
+      // the second pass over the deferred moves.
+      ThreadHolding holding(thisThread, pos.hash_key(), Abdada && depth >= AbdadaDepth);
+
+      if (holding.marked() && moveCount > 1 && !deferredIdx)
+      {
+          pos.undo_move(move);
+          ss->moveCount = --moveCount;
+          deferred[deferredCount++] = move;
+          continue;
+      }
+
+      uint64_t nodesBefore = thisThread->nodes.fetch_add(1, std::memory_order_relaxed);
+
+      // Update the current move
+      ss->currentMove = move;
+      ss->continuationHistory = &thisThread->continuationHistory[movedPiece][to];
+
+      // Check extension, limited to twice the root depth so that long chains
+      // of checks cannot blow up the tree.
+      Depth extension = givesCheck && ply < 2 * thisThread->rootDepth;
+
+      Depth newDepth = depth - 1 + extension;
+      Value childBeta = beta;
+      bool doFullDepthSearch;
+
+      // Late move reduction: moves late in the list are searched at a
+      // reduced depth with a null window first, and again at full depth only
+      // if they beat alpha. Captures, checks and PV nodes are reduced less.
+      if (    depth >= 3
+          &&  moveCount > 1 + 2 * PvNode
+          && !givesCheck)
+      {
+          Depth r = reduction(improving, depth, moveCount) - PvNode;
+
+          if (capture)
+              r--;
+
+          // Decrease/increase reduction for moves with a good/bad history
+          else
+          {
+              int statScore =  thisThread->mainHistory[us][move_source_square(move)][to]
+                             + (*contHist[0])[movedPiece][to]
+                             + (*contHist[1])[movedPiece][to]
+                             - 4923;
+
+              r -= statScore / 14721;
+          }
+
+          Depth d = std::clamp(newDepth - r, 1, newDepth);
+
+          value = -search<NonPV>(pos, ss+1, -(alpha + 1), -alpha, d);
+          childBeta = alpha + 1;
+
+          doFullDepthSearch = value > alpha && d < newDepth;
+      }
+      else
+          doFullDepthSearch = !PvNode || moveCount > 1;
+
+      // Full depth search when LMR is skipped or fails high. Only the
+      // first move of a PV node is searched with a full window up front.
+      if (doFullDepthSearch)
+      {
+          value = -search<NonPV>(pos, ss+1, -(alpha + 1), -alpha, newDepth);
+          childBeta = alpha + 1;
+      }
+
+      // For PV nodes only, do a full PV search on the first move or after a fail
+      // high (in the latter case search only if value < beta), otherwise let the
+      // parent node fail low with value <= alpha and try another move.
+      if (PvNode && (moveCount == 1 || (value > alpha && (rootNode || value < beta))))
+      {
+          (ss+1)->pv = pv;
+          (ss+1)->pv[0] = MOVE_NONE;
+
+          value = -search<PV>(pos, ss+1, -beta, -alpha, newDepth);
+          childBeta = beta;
+      }
+
+      // dump the child node from its own point of view
+      if (ply < thisThread->dumpDepth)
+          TreeDump::write(ply + 1, move, -childBeta, -alpha, -value,
+                          thisThread->nodes.load(std::memory_order_relaxed) - nodesBefore);
+
       // take back
       pos.undo_move(move);
-      
+
+      // Finished searching the move. If a stop occurred, the return value of
+      // the search cannot be trusted, and we return immediately without
+      // updating best move, PV and TT.
+      if (stopped(thisThread))
+          return VALUE_ZERO;
+
+      if (rootNode)
+      {
+          RootMove& rm = *std::find(thisThread->rootMoves.begin(),
+                                    thisThread->rootMoves.end(), move);
+
+          // PV move or new best move?
+          if (moveCount == 1 || value > alpha)
+          {
+              rm.score = value;
+              rm.selDepth = thisThread->selDepth;
+              rm.pv.resize(1);
+
+              for (Move* m = (ss+1)->pv; *m != MOVE_NONE; ++m)
+                  rm.pv.push_back(*m);
+          }
+          else
+              // All other moves but the PV are set to the lowest value: this
+              // is not a problem when sorting because the sort is stable and the
+              // move position in the list is preserved - just the PV is pushed up.
+              rm.score = -VALUE_INFINITE;
+      }
+
       if (value > bestValue)
       {
         bestValue = value;
 
         if (value > alpha) {
-          // update best move
           bestMove = move;
-          globalBestMove = bestMove;
-          
-          // TODO update PV
-          
-          
+
+          if (PvNode && !rootNode) // Update pv even in fail-high case
+              update_pv(ss->pv, move, (ss+1)->pv);
+
           alpha = value;
-          
+
           if (value >= beta) {
-            return beta;
+            update_all_stats(pos, ss, move, depth,
+                             quietsSearched, quietCount, capturesSearched, captureCount);
+            TreeStats& ts = thisThread->treeStats;
+            ++ts.cutoffs[ply];
+            ts.firstMoveCutoffs[ply] += (moveCount == 1);
+            ts.movesBeforeCutoff[ply] += moveCount;
+            bestValue = beta;
+            break;
           }
         }
       }
+
+      if (capture && captureCount < 32)
+          capturesSearched[captureCount++] = move;
+
+      else if (!capture && quietCount < 64)
+          quietsSearched[quietCount++] = move;
     }
-    
-    globalBestMove = bestMove;
+
+    // No legal move: a loss in xiangqi, whether checkmate or stalemate
+    if (!moveCount)
+        bestValue = mated_in(ply);
+
+    // Write gathered information in transposition table
+    tte->save(posKey, value_to_tt(bestValue, ply), PvNode,
+              bestValue >= beta ? BOUND_LOWER :
+              PvNode && bestMove ? BOUND_EXACT : BOUND_UPPER,
+              depth, bestMove, ss->staticEval);
+
+    return bestValue;
+  }
+
+
+  // qsearch() is the quiescence search function, which is called by the main
+  // search function with zero depth. Only captures are searched, the static
+  // eval standing in for the quiet alternatives, except when in check where
+  // all the moves are tried.
+
+  template <NodeType nodeType>
+  Value qsearch(Position& pos, Stack* ss, Value alpha, Value beta) {
+    TRACE_SCOPE(SEARCH);
+
+    constexpr bool PvNode = nodeType == PV;
+
+    assert(alpha >= -VALUE_INFINITE && alpha < beta && beta <= VALUE_INFINITE);
+    assert(PvNode || (alpha == beta - 1));
+
+    Move pv[MAX_PLY+1], move;
+    Value bestValue, value;
+    StateInfo st;
+    Thread* thisThread = pos.this_thread();
+    int ply = ss->ply;
+
+    if (PvNode)
+    {
+        (ss+1)->pv = pv;
+        ss->pv[0] = MOVE_NONE;
+    }
+
+    // Check for the available remaining time
+    if (thisThread == Threads.main())
+        static_cast<MainThread*>(thisThread)->check_time();
+
+    if (stopped(thisThread))
+        return VALUE_ZERO;
+
+    ++thisThread->treeStats.nodes[std::min(ply, MAX_PLY - 1)];
+    ++thisThread->treeStats.qsearchNodes;
+
+    if (ply >= MAX_PLY)
+        return evaluate(pos);
+
+    ss->inCheck = pos.in_check();
+
+    // Stand pat. Return immediately if static value is at least beta
+    if (ss->inCheck)
+        ss->staticEval = bestValue = -VALUE_INFINITE;
+    else
+    {
+        ss->staticEval = bestValue = evaluate(pos);
+
+        if (bestValue >= beta)
+            return beta;
+
+        if (bestValue > alpha)
+            alpha = bestValue;
+    }
+
+    Move prevMove = (ss-1)->currentMove;
+    Move counterMove = thisThread->counterMoves[move_source_piece(prevMove)][move_target_square(prevMove)];
+    const PieceToHistory* contHist[] = { (ss-1)->continuationHistory, (ss-2)->continuationHistory };
+
+    MovePicker mp = ss->inCheck ? MovePicker(pos, MOVE_NONE, &thisThread->mainHistory, &thisThread->captureHistory,
+                                             contHist, counterMove, ss->killers)
+                                : MovePicker(pos, &thisThread->captureHistory);
+
+    // Loop through the moves until no moves remain or a beta cutoff occurs
+    while ((move = mp.next_move()) != MOVE_NONE)
+    {
+      if (pos.do_move(move, st) == false) {
+        ++thisThread->treeStats.illegalMoves;
+        continue;
+      }
+
+      thisThread->nodes.fetch_add(1, std::memory_order_relaxed);
+
+      ss->currentMove = move;
+      ss->continuationHistory = &thisThread->continuationHistory[move_source_piece(move)]
+                                                                [move_target_square(move)];
+
+      value = -qsearch<nodeType>(pos, ss+1, -beta, -alpha);
+      pos.undo_move(move);
+
+      if (stopped(thisThread))
+          return VALUE_ZERO;
+
+      if (value > bestValue)
+      {
+          bestValue = value;
+
+          if (value > alpha)
+          {
+              if (PvNode) // Update pv even in fail-high case
+                  update_pv(ss->pv, move, (ss+1)->pv);
+
+              if (value >= beta)
+                  return beta;
+
+              alpha = value;
+          }
+      }
+    }
+
+    // All legal moves have been searched. A special case: if we're in check
+    // and no legal moves were found, it is checkmate.
+    if (ss->inCheck && bestValue == -VALUE_INFINITE)
+        return mated_in(ply);
+
     return bestValue;
   }
 
 
+  // value_to_tt() adjusts a mate score from "plies to mate from the root" to
+  // "plies to mate from the current position". Standard scores are unchanged.
+  // The function is called before storing a value in the transposition table.
+
+  Value value_to_tt(Value v, int ply) {
+
+    assert(v != VALUE_NONE);
+
+    return  v >= VALUE_MATE_IN_MAX_PLY  ? v + ply
+          : v <= VALUE_MATED_IN_MAX_PLY ? v - ply : v;
+  }
+
+
+  // value_from_tt() is the inverse of value_to_tt(): it adjusts a mate score
+  // from the transposition table (which refers to the plies to mate from the
+  // position where it was stored) to "plies to mate from the root".
+
+  Value value_from_tt(Value v, int ply) {
+
+    return  v == VALUE_NONE             ? VALUE_NONE
+          : v >= VALUE_MATE_IN_MAX_PLY  ? v - ply
+          : v <= VALUE_MATED_IN_MAX_PLY ? v + ply : v;
+  }
+
+
+  // mate() is the node function of the mate search. The attacker, to move
+  // at the root, tries only checking moves, the defender all its moves. With
+  // no mate found within depth the node returns VALUE_ZERO, and a defender
+  // left without legal moves is mated. Mate distance pruning bounds the
+  // window by the shortest possible mate from this node.
+
+  template <bool Attacker>
+  Value mate(Position& pos, Stack* ss, Value alpha, Value beta, Depth depth) {
+
+    Move pv[MAX_PLY+1], move;
+    Value bestValue = -VALUE_INFINITE, value;
+    StateInfo st;
+    Thread* thisThread = pos.this_thread();
+    int ply = ss->ply;
+    int moveCount = 0;
+
+    (ss+1)->pv = pv;
+    ss->pv[0] = MOVE_NONE;
+
+    // Check for the available remaining time
+    if (thisThread == Threads.main())
+        static_cast<MainThread*>(thisThread)->check_time();
+
+    if (stopped(thisThread))
+        return VALUE_ZERO;
+
+    // Mate distance pruning. Even if we mate at the next move our score
+    // would be at best mate_in(ply + 1), and if we are mated now it is
+    // mated_in(ply).
+    alpha = std::max(mated_in(ply), alpha);
+    beta = std::min(mate_in(ply + 1), beta);
+    if (alpha >= beta)
+        return alpha;
+
+    (ss+2)->killers[0] = (ss+2)->killers[1] = MOVE_NONE;
+
+    Move prevMove = (ss-1)->currentMove;
+    Move counterMove = thisThread->counterMoves[move_source_piece(prevMove)][move_target_square(prevMove)];
+    const PieceToHistory* contHist[] = { (ss-1)->continuationHistory, (ss-2)->continuationHistory };
+
+    MovePicker mp(pos, MOVE_NONE, &thisThread->mainHistory, &thisThread->captureHistory,
+                  contHist, counterMove, ss->killers);
+
+    while ((move = mp.next_move()) != MOVE_NONE)
+    {
+      // At root obey the "searchmoves" option and skip moves not listed in Root
+      // Move List.
+      if (Attacker && !ply && !std::count(thisThread->rootMoves.begin(),
+                                          thisThread->rootMoves.end(), move))
+          continue;
+
+      if (pos.do_move(move, st) == false)
+          continue;
+
+      ++moveCount;
+
+      // At the horizon only the existence of a legal move matters
+      if (!depth || (Attacker && !pos.in_check()))
+      {
+          pos.undo_move(move);
+
+          if (!depth)
+              break;
+
+          continue;
+      }
+
+      thisThread->nodes.fetch_add(1, std::memory_order_relaxed);
+
+      ss->currentMove = move;
+      ss->continuationHistory = &thisThread->continuationHistory[move_source_piece(move)]
+                                                                [move_target_square(move)];
+
+      value = -mate<!Attacker>(pos, ss+1, -beta, -alpha, depth - 1);
+      pos.undo_move(move);
+
+      if (stopped(thisThread))
+          return VALUE_ZERO;
+
+      if (value > bestValue)
+      {
+          bestValue = value;
+
+          if (value > alpha)
+          {
+              update_pv(ss->pv, move, (ss+1)->pv);
+
+              if (value >= beta)
+              {
+                  if (!move_capture_flag(move) && ss->killers[0] != move)
+                  {
+                      ss->killers[1] = ss->killers[0];
+                      ss->killers[0] = move;
+                  }
+                  break;
+              }
+
+              alpha = value;
+          }
+      }
+    }
+
+    // No legal move: checkmate or stalemate, both a loss in xiangqi
+    if (!moveCount)
+        return mated_in(ply);
+
+    // No move searched, at the horizon or for want of a check
+    return bestValue == -VALUE_INFINITE ? VALUE_ZERO : bestValue;
+  }
+
+
+  // update_pv() adds current move and appends child pv[]
+
+  void update_pv(Move* pv, Move move, Move* childPv) {
+
+    for (*pv++ = move; childPv && *childPv != MOVE_NONE; )
+        *pv++ = *childPv++;
+    *pv = MOVE_NONE;
+  }
+
+
+  // update_continuation_histories() updates histories of the move pairs formed
+  // by moves at ply - 1 and ply - 2 with the current move.
+
+  void update_continuation_histories(Stack* ss, Piece pc, Square to, int bonus) {
+
+    for (int i : {1, 2})
+    {
+        Move prev = (ss-i)->currentMove;
+
+        if (prev != MOVE_NONE && prev != MOVE_NULL)
+            (*(ss-i)->continuationHistory)[pc][to] << bonus;
+    }
+  }
+
+
+  // update_quiet_stats() updates the butterfly and continuation histories of
+  // a quiet move by the given bonus (or malus when negative), and the killers
+  // when the move is a cutoff move.
+
+  void update_quiet_stats(const Position& pos, Stack* ss, Move move, int bonus) {
+
+    // Update killers
+    if (bonus > 0 && ss->killers[0] != move)
+    {
+        ss->killers[1] = ss->killers[0];
+        ss->killers[0] = move;
+    }
+
+    Color us = pos.side_to_move();
+    Square to = move_target_square(move);
+
+    pos.this_thread()->mainHistory[us][move_source_square(move)][to] << bonus;
+    update_continuation_histories(ss, move_source_piece(move), to, bonus);
+  }
+
+
+  // update_all_stats() updates stats at the end of search() when a bestMove
+  // caused a beta cutoff: the move gets a bonus, and all the other moves of
+  // the same kind searched before it get a malus.
+
+  void update_all_stats(const Position& pos, Stack* ss, Move bestMove, Depth depth,
+                        Move* quietsSearched, int quietCount, Move* capturesSearched, int captureCount) {
+
+    Thread* thisThread = pos.this_thread();
+    CapturePieceToHistory& captureHistory = thisThread->captureHistory;
+    int bonus = stat_bonus(depth + 1);
+
+    if (!move_capture_flag(bestMove))
+    {
+        update_quiet_stats(pos, ss, bestMove, bonus);
+
+        // Decrease stats for all non-best quiet moves
+        for (int i = 0; i < quietCount; ++i)
+            update_quiet_stats(pos, ss, quietsSearched[i], -bonus);
+
+        // Update countermove history
+        Move prev = (ss-1)->currentMove;
+        if (prev != MOVE_NONE && prev != MOVE_NULL)
+            thisThread->counterMoves[move_source_piece(prev)][move_target_square(prev)] = bestMove;
+    }
+    else
+        captureHistory[move_source_piece(bestMove)][move_target_square(bestMove)]
+                      [PIECE_TYPE[move_target_piece(bestMove)]] << bonus;
+
+    // Decrease stats for all non-best capture moves
+    for (int i = 0; i < captureCount; ++i)
+        captureHistory[move_source_piece(capturesSearched[i])][move_target_square(capturesSearched[i])]
+                      [PIECE_TYPE[move_target_piece(capturesSearched[i])]] << -bonus;
+  }
 
 } // namespace
 
+
+/// MainThread::check_time() is used to print debug info and, more importantly,
+/// to detect when we are out of available time and thus stop the search.
+
+void MainThread::check_time() {
+
+  if (--callsCnt > 0)
+      return;
+
+  // Every node entered counts one move made, so with a node limit the next
+  // check is scheduled exactly when the limit will be reached. This makes
+  // 'go nodes' stop at the same node, and thus reproducible, with one thread.
+  // In deterministic mode the threads keep to their own node budgets instead.
+  int64_t searched = int64_t(Threads.nodes_searched());
+  bool nodeLimit = Limits.nodes && !Threads.deterministic;
+
+  callsCnt = nodeLimit ? int(std::clamp(Limits.nodes - searched, int64_t(0), int64_t(1024))) : 1024;
+
+  if (nodeLimit && searched >= Limits.nodes)
+      Threads.stop = true;
+
+  // We should not stop pondering until told so by the GUI
+  if (ponder)
+      return;
+
+  TimePoint elapsed = Time.elapsed();
+
+  if (   (Limits.use_time_management() && (elapsed > Time.maximum() - 10 || stopOnPonderhit))
+      || (Limits.movetime && elapsed >= Limits.movetime))
+      Threads.stop = true;
+}
+
+
+/// UCI::pv() formats PV information according to the UCI protocol. UCI requires
+/// that all (if any) unsearched PV lines are sent using a previous search score.
+
+string UCI::pv(const Position& pos, Depth depth, Value alpha, Value beta) {
+
+  std::stringstream ss;
+  TimePoint elapsed = now() - Limits.startTime + 1; // Ensure positivity to avoid a 'divide by zero'
+  const RootMoves& rootMoves = pos.this_thread()->rootMoves;
+  size_t pvIdx = pos.this_thread()->pvIdx;
+  size_t multiPV = std::min(size_t(Options["MultiPV"]), rootMoves.size());
+  uint64_t nodesSearched = Threads.nodes_searched() + Cluster::nodes_searched();
+
+  for (size_t i = 0; i < multiPV; ++i)
+  {
+      bool updated = rootMoves[i].score != -VALUE_INFINITE;
+
+      if (depth == 1 && !updated && i > 0)
+          continue;
+
+      Depth d = updated ? depth : std::max(1, depth - 1);
+      Value v = updated ? rootMoves[i].score : rootMoves[i].previousScore;
+
+      if (v == -VALUE_INFINITE)
+          v = VALUE_ZERO;
+
+      if (ss.rdbuf()->in_avail()) // Not at first line
+          ss << "\n";
+
+      // A cluster coordinator compares our scores with its own ones
+      if (i == 0 && Cluster::serving())
+          ss << "info string cluster score " << v << "\n";
+
+      ss << "info"
+         << " depth "    << d
+         << " seldepth " << rootMoves[i].selDepth
+         << " multipv "  << i + 1
+         << " score "    << UCI::value(v);
+
+      if (i == pvIdx)
+          ss << (v >= beta ? " lowerbound" : v <= alpha ? " upperbound" : "");
+
+      ss << " nodes "    << nodesSearched
+         << " nps "      << nodesSearched * 1000 / elapsed;
+
+      if (elapsed > 1000) // Earlier makes little sense
+          ss << " hashfull " << TT.hashfull();
+
+      ss << " time "     << elapsed
+         << " pv";
+
+      for (Move m : rootMoves[i].pv)
+          ss << " " << UCI::move(m);
+  }
+
+  return ss.str();
+}
+
 } // namespace Stockfish
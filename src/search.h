@@ -22,6 +22,7 @@
 #include <vector>
 
 #include "misc.h"
+#include "movepick.h"
 #include "types.h"
 
 namespace Stockfish {
@@ -30,13 +31,64 @@ class Position;
 
 namespace Search {
 
+/// Stack struct keeps track of the information we need to remember from nodes
+/// shallower and deeper in the tree during the search. The search passes a
+/// pointer to the entry of the current ply down the recursion, and a few
+/// sentinel entries in front of the root make looking back by ply - 2 safe.
+
+struct Stack {
+  Move* pv;
+  PieceToHistory* continuationHistory;
+  int ply;
+  Move currentMove;
+  Move killers[2];
+  Value staticEval;
+  int moveCount;
+  bool inCheck;
+};
+
+
+/// RootMove struct is used for moves at the root of the tree. For each root move
+/// we store a score and a PV (really a refutation in the case of moves which
+/// fail low). Score is normally set at -VALUE_INFINITE for all non-pv moves.
+
+struct RootMove {
+
+  explicit RootMove(Move m) : pv(1, m) {}
+  bool operator==(const Move& m) const { return pv[0] == m; }
+  bool operator<(const RootMove& m) const { // Sort in descending order
+    return m.score != score ? m.score < score
+                            : m.previousScore < previousScore;
+  }
+
+  Value score = -VALUE_INFINITE;
+  Value previousScore = -VALUE_INFINITE;
+  int selDepth = 0;
+  std::vector<Move> pv;
+};
+
+typedef std::vector<RootMove> RootMoves;
+
+
+/// TreeStats records the shape of the last search tree, indexed by ply from
+/// the root, for the 'stats' command. Move ordering is tuned against these.
+
+struct TreeStats {
+  uint64_t nodes[MAX_PLY];
+  uint64_t cutoffs[MAX_PLY];
+  uint64_t firstMoveCutoffs[MAX_PLY];
+  uint64_t movesBeforeCutoff[MAX_PLY];
+  uint64_t illegalMoves;
+  uint64_t qsearchNodes;
+};
+
 
 /// LimitsType struct stores information sent by GUI about available time to
 /// search the current move, maximum depth/time, or if we are in analysis mode.
 
 struct LimitsType {
   LimitsType() { // Init explicitly due to broken value-initialization of non POD in MSVC
-    time[WHITE] = time[BLACK] = inc[WHITE] = inc[BLACK] = npmsec = movetime = TimePoint(0);
+    time[WHITE] = time[BLACK] = inc[WHITE] = inc[BLACK] = npmsec = movetime = startTime = TimePoint(0);
     movestogo = depth = mate = perft = infinite = 0;
     nodes = 0;
   }
@@ -56,7 +108,8 @@ extern LimitsType Limits;
 void init();
 void clear();
 void perftTest(Position& pos, Depth depth);
-void sync_search(Position& pos, LimitsType& limits);
+uint64_t nodes_searched();
+void print_stats(bool json);
 
 } // namespace Search
 
@@ -0,0 +1,381 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2021 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cassert>
+#include <cstdlib>
+
+#include <algorithm> // For std::count, std::rotate
+#include <iostream>
+#include <map>
+
+#include "cluster.h"
+#include "movegen.h"
+#include "search.h"
+#include "thread.h"
+#include "tt.h"
+#include "uci.h"
+
+namespace Stockfish {
+
+ThreadPool Threads; // Global object
+
+
+/// Thread constructor launches the thread and waits until it goes to sleep
+/// in idle_loop(). Note that 'searching' and 'exit' should be already set.
+
+Thread::Thread(size_t n) : idx(n), stdThread(&Thread::idle_loop, this) {
+
+  wait_for_search_finished();
+}
+
+
+/// Thread destructor wakes up the thread in idle_loop() and waits
+/// for its termination. Thread should be already waiting.
+
+Thread::~Thread() {
+
+  assert(!searching);
+
+  exit = true;
+  start_searching();
+  stdThread.join();
+}
+
+
+/// Thread::operator new() and Thread::operator delete() keep the threads, most
+/// of which is history tables, on large pages when possible.
+
+void* Thread::operator new(size_t size) {
+
+  void* mem = aligned_large_pages_alloc(size);
+  if (!mem)
+  {
+      std::cerr << "Failed to allocate " << (size >> 20) << "MB for a thread." << std::endl;
+      std::exit(EXIT_FAILURE);
+  }
+
+  return mem;
+}
+
+void Thread::operator delete(void* mem) {
+
+  aligned_large_pages_free(mem);
+}
+
+
+/// Thread::clear() reset histories, usually before a new game
+
+void Thread::clear() {
+
+  counterMoves.fill(MOVE_NONE);
+  mainHistory.fill(0);
+  captureHistory.fill(0);
+
+  for (auto& to : continuationHistory)
+      for (auto& h : to)
+          h->fill(0);
+}
+
+
+/// Thread::start_searching() wakes up the thread that will start the search
+
+void Thread::start_searching() {
+
+  std::lock_guard<std::mutex> lk(mutex);
+  searching = true;
+  cv.notify_one(); // Wake up the thread in idle_loop()
+}
+
+
+/// Thread::run_custom_job() queues the given function, to be run by the thread
+/// instead of a search, and returns immediately. Used for work that should
+/// happen on the thread's own processor and NUMA node, or in the background.
+/// The thread counts as searching until its queue is empty. Must not be called
+/// while the thread is searching.
+
+void Thread::run_custom_job(std::function<void()> f) {
+
+  std::lock_guard<std::mutex> lk(mutex);
+  jobs.push_back(std::move(f));
+  searching = true;
+  cv.notify_one(); // Wake up the thread in idle_loop()
+}
+
+
+/// Thread::wait_for_search_finished() blocks on the condition variable
+/// until the thread has finished searching.
+
+void Thread::wait_for_search_finished() {
+
+  std::unique_lock<std::mutex> lk(mutex);
+  cv.wait(lk, [&]{ return !searching; });
+}
+
+
+/// Thread::idle_loop() is where the thread is parked, blocked on the
+/// condition variable, when it has no work to do.
+
+void Thread::idle_loop() {
+
+#if defined(__linux__) && !defined(__ANDROID__)
+  // On Linux the threads are bound whenever there are several NUMA nodes, so
+  // that the tables of every thread are local to it, see bindThisThread().
+  WinProcGroup::bindThisThread(idx);
+#else
+  // If OS already scheduled us on a different group than 0 then don't overwrite
+  // the choice, eventually we are one of many one-threaded processes running on
+  // some Windows NUMA hardware, for instance in fishtest. To make it simple,
+  // just check if running threads are below a threshold, in this case all this
+  // NUMA machinery is not needed.
+  if (Options["Threads"] > 8)
+      WinProcGroup::bindThisThread(idx);
+#endif
+
+  PerfCounters::register_thread();
+
+  while (true)
+  {
+      std::unique_lock<std::mutex> lk(mutex);
+
+      if (jobs.empty())
+      {
+          searching = false;
+          cv.notify_one(); // Wake up anyone waiting for search finished
+          cv.wait(lk, [&]{ return searching; });
+      }
+
+      if (exit)
+          return;
+
+      std::function<void()> job;
+
+      if (!jobs.empty())
+          job = std::move(jobs.front()), jobs.pop_front();
+
+      lk.unlock();
+
+      if (job)
+          job();
+      else
+          search();
+  }
+}
+
+/// ThreadPool::set() creates/destroys threads to match the requested number.
+/// Created and launched threads will immediately go to sleep in idle_loop.
+/// Upon resizing, threads are recreated to allow for binding if necessary.
+
+void ThreadPool::set(size_t requested) {
+
+  if (size() > 0)   // destroy any existing thread(s)
+  {
+      stop_speculation();
+      main()->wait_for_search_finished();
+      wait_for_search_finished(); // Background jobs
+
+      while (size() > 0)
+          delete back(), pop_back();
+  }
+
+  if (requested > 0)   // create new thread(s)
+  {
+      push_back(new MainThread(0));
+
+      while (size() < requested)
+          push_back(new Thread(size()));
+      clear();
+
+      // Reallocate the hash with the new threadpool size
+      TT.resize(size_t(Options["Hash"]));
+  }
+}
+
+
+/// ThreadPool::clear() sets threadPool data to initial values. Every thread
+/// clears its own histories, so that their memory is first touched, and thus
+/// allocated, on the NUMA node the thread is bound to. This happens in the
+/// background, the next search waits for it.
+
+void ThreadPool::clear() {
+
+  for (Thread* th : *this)
+      th->run_custom_job([th]() { th->clear(); });
+
+  main()->callsCnt = 0;
+  main()->speculations.clear();
+}
+
+
+/// ThreadPool::start_thinking() wakes up main thread waiting in idle_loop() and
+/// returns immediately. Main thread will wake up other threads and start the search.
+
+void ThreadPool::start_thinking(Position& pos, const Search::LimitsType& limits, bool ponderMode) {
+
+  stop_speculation();
+  main()->wait_for_search_finished();
+  wait_for_search_finished(); // Background jobs, e.g. clearing the hash
+
+  main()->callsCnt = 0;
+  main()->stopOnPonderhit = stop = false;
+  main()->ponder = ponderMode;
+  Search::Limits = limits;
+  Search::RootMoves rootMoves;
+  StateInfo st;
+
+  // Collect the legal root moves, restricted to 'searchmoves' if given
+  for (const auto& m : MoveList<PSEUDO_LEGAL>(pos))
+      if (   (limits.searchmoves.empty() || std::count(limits.searchmoves.begin(), limits.searchmoves.end(), m))
+          && pos.do_move(m, st))
+      {
+          pos.undo_move(m);
+          rootMoves.emplace_back(m);
+      }
+
+  // If this position was searched while waiting for the opponent, start from
+  // the best line found. The deeper part of that search is in the hash table.
+  auto it = main()->speculations.find(pos.hash_key());
+  auto rm = it != main()->speculations.end() ? std::find(rootMoves.begin(), rootMoves.end(),
+                                                         it->second.rootMove.pv[0])
+                                             : rootMoves.end();
+  if (rm != rootMoves.end())
+  {
+      *rm = it->second.rootMove;
+      std::rotate(rootMoves.begin(), rm, rm + 1);
+
+      sync_cout << "info string speculative search hit, depth " << it->second.depth
+                << " move " << UCI::move(rootMoves[0].pv[0]) << sync_endl;
+  }
+
+  main()->speculations.clear();
+
+  // With cluster workers connected, keep only our share of the root moves
+  Cluster::start(Search::Limits, rootMoves);
+
+  // In deterministic mode the root moves are dealt out to the threads, which
+  // search them with their own part of the hash table and of the node limit,
+  // so that nothing depends on the relative speed of the threads.
+  deterministic = Options["Deterministic SMP"];
+  split = deterministic || Cluster::active();
+  size_t workers = deterministic ? std::min(size(), rootMoves.size()) : 1;
+
+  TT.partition(deterministic ? size() : 1);
+
+  // Every thread gets its own copy of the root position. As the repetition
+  // history lives in the position itself, the setup states are not needed.
+  for (size_t i = 0; i < size(); ++i)
+  {
+      Thread* th = (*this)[i];
+
+      th->nodes = th->nmpMinPly = 0;
+      th->rootDepth = th->completedDepth = 0;
+      th->rootPos.set(pos, &th->rootState, th);
+      th->nodeBudget = 0;
+      th->ttPart = 0;
+      th->iterationBest.clear();
+
+      if (!deterministic)
+      {
+          th->rootMoves = rootMoves;
+          continue;
+      }
+
+      th->rootMoves.clear();
+      for (size_t j = i; j < rootMoves.size(); j += size())
+          th->rootMoves.push_back(rootMoves[j]);
+
+      uint64_t nodes = uint64_t(Search::Limits.nodes); // Our share with cluster workers
+
+      if (nodes && i < workers)
+          th->nodeBudget = std::max(nodes / workers + (i < nodes % workers), uint64_t(1));
+
+      th->ttPart = i;
+  }
+
+  main()->start_searching();
+}
+
+
+/// ThreadPool::get_best_thread() picks the thread whose best move got the
+/// most votes, weighted by score and completed depth.
+
+Thread* ThreadPool::get_best_thread() const {
+
+    Thread* bestThread = front();
+    std::map<Move, int64_t> votes;
+    Value minScore = VALUE_NONE;
+
+    // Find minimum score of all threads
+    for (Thread* th: *this)
+        minScore = std::min(minScore, th->rootMoves[0].score);
+
+    // Vote according to score and depth, and select the best thread
+    for (Thread* th : *this)
+    {
+        votes[th->rootMoves[0].pv[0]] +=
+            (th->rootMoves[0].score - minScore + 14) * int(th->completedDepth);
+
+        if (abs(bestThread->rootMoves[0].score) >= VALUE_MATE_IN_MAX_PLY)
+        {
+            // Make sure we pick the shortest mate or stave off mate the longest
+            if (th->rootMoves[0].score > bestThread->rootMoves[0].score)
+                bestThread = th;
+        }
+        else if (   th->rootMoves[0].score >= VALUE_MATE_IN_MAX_PLY
+                 || (   th->rootMoves[0].score > VALUE_MATED_IN_MAX_PLY
+                     && votes[th->rootMoves[0].pv[0]] > votes[bestThread->rootMoves[0].pv[0]]))
+            bestThread = th;
+    }
+
+    return bestThread;
+}
+
+
+/// ThreadPool::stop_speculation() ends the speculative search started after
+/// the last move, if any, and waits until all the threads are idle again.
+
+void ThreadPool::stop_speculation() {
+
+  if (speculating)
+  {
+      stop = true;
+      main()->wait_for_search_finished();
+  }
+}
+
+
+/// Start non-main threads
+
+void ThreadPool::start_searching() {
+
+    for (Thread* th : *this)
+        if (th != front())
+            th->start_searching();
+}
+
+
+/// Wait for non-main threads, also used after waiting for the main thread to
+/// wait for the background jobs of all the threads.
+
+void ThreadPool::wait_for_search_finished() const {
+
+    for (Thread* th : *this)
+        if (th != front())
+            th->wait_for_search_finished();
+}
+
+} // namespace Stockfish
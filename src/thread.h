@@ -0,0 +1,153 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2021 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef THREAD_H_INCLUDED
+#define THREAD_H_INCLUDED
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "movepick.h"
+#include "position.h"
+#include "search.h"
+#include "thread_win32_osx.h"
+
+namespace Stockfish {
+
+/// Thread class keeps together all the thread-related stuff. We use
+/// per-thread history tables and root positions, the transposition table
+/// being the only state shared by the threads of a search.
+
+class Thread {
+
+  std::mutex mutex;
+  std::condition_variable cv;
+  size_t idx;
+  bool exit = false, searching = true; // Set before starting std::thread
+  std::deque<std::function<void()>> jobs;
+  NativeThread stdThread;
+
+public:
+  explicit Thread(size_t);
+  virtual ~Thread();
+  static void* operator new(size_t size);
+  static void operator delete(void* mem);
+  virtual void search();
+  void clear();
+  void idle_loop();
+  void start_searching();
+  void run_custom_job(std::function<void()> f);
+  void wait_for_search_finished();
+  size_t id() const { return idx; }
+
+  size_t pvIdx;
+  int selDepth, nmpMinPly, dumpDepth;
+  Color nmpColor;
+  std::atomic<uint64_t> nodes;
+
+  Position rootPos;
+  StateInfo rootState;
+  Search::RootMoves rootMoves;
+  Depth rootDepth, completedDepth;
+  ButterflyHistory mainHistory;
+  CapturePieceToHistory captureHistory;
+  CounterMoveHistory counterMoves;
+  ContinuationHistory continuationHistory;
+  Search::TreeStats treeStats;
+
+  // Deterministic mode: own share of the node limit, zero for none, and the
+  // hash table partition. With the root moves split, in deterministic or
+  // cluster mode, the best move of every completed iteration.
+  uint64_t nodeBudget;
+  size_t ttPart;
+  std::vector<Search::RootMove> iterationBest;
+};
+
+
+/// Speculation is the outcome of the search of a likely opponent reply, done
+/// while waiting for the opponent to move (see MainThread::speculate()).
+
+struct Speculation {
+  Depth depth;
+  Search::RootMove rootMove;
+};
+
+
+/// MainThread is a derived class specific for main thread
+
+struct MainThread : public Thread {
+
+  using Thread::Thread;
+
+  void search() override;
+  void speculate(Move best, Move expected);
+  void search_mate();
+  Depth gathered_depth();
+  Search::RootMoves gather(Depth depth);
+  void print_gathered(Depth depth);
+  void check_time();
+
+  int callsCnt;
+  Depth printedDepth;
+  bool stopOnPonderhit;
+  std::atomic_bool ponder;
+  std::unordered_map<Key, Speculation> speculations;
+};
+
+
+/// ThreadPool struct handles all the threads-related stuff like init, starting,
+/// parking and, most importantly, launching a thread. All the access to threads
+/// is done through this class.
+
+struct ThreadPool : public std::vector<Thread*> {
+
+  void start_thinking(Position&, const Search::LimitsType&, bool = false);
+  void clear();
+  void set(size_t);
+
+  MainThread* main()        const { return static_cast<MainThread*>(front()); }
+  uint64_t nodes_searched() const { return accumulate(&Thread::nodes); }
+
+  Thread* get_best_thread() const;
+  void start_searching();
+  void wait_for_search_finished() const;
+  void stop_speculation();
+
+  std::atomic_bool stop, speculating;
+  bool deterministic, split;
+
+private:
+  uint64_t accumulate(std::atomic<uint64_t> Thread::* member) const {
+
+    uint64_t sum = 0;
+    for (Thread* th : *this)
+        sum += (th->*member).load(std::memory_order_relaxed);
+    return sum;
+  }
+};
+
+extern ThreadPool Threads;
+
+} // namespace Stockfish
+
+#endif // #ifndef THREAD_H_INCLUDED
@@ -0,0 +1,277 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2021 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cstring>   // For std::memcpy
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <vector>
+
+#include "misc.h"
+#include "treedump.h"
+#include "uci.h"
+
+namespace Stockfish {
+
+namespace {
+
+  // File layout: a 12 bytes header (magic, version, record size) followed by
+  // records of 20 bytes in native byte order:
+  //
+  //   0  uint64  nodes in the subtree, the node itself included
+  //   8  uint32  move leading to the node, MOVE_NONE at the root
+  //  12  int16   alpha
+  //  14  int16   beta
+  //  16  int16   returned value
+  //  18  uint8   ply
+  //  19  uint8   unused
+  constexpr char Magic[4] = { 'X', 'Q', 'T', 'D' };
+  constexpr uint32_t Version = 1;
+  constexpr uint32_t RecordSize = 20;
+  constexpr size_t BufferSize = RecordSize * 65536;
+
+  std::ofstream file;
+  std::vector<char> buffer;
+
+  struct Node {
+    Move move;
+    uint64_t nodes;
+    std::vector<Node> children;
+  };
+
+  struct PathStats {
+    uint64_t visits, nodes;
+  };
+
+  // aggregate() sums the node counts of 'node' and of its descendants into
+  // 'paths', keyed by the sequence of moves from the root, up to 'maxLength'.
+  void aggregate(const Node& node, std::vector<Move>& path, size_t maxLength,
+                 std::map<std::vector<Move>, PathStats>& paths) {
+
+    if (!path.empty())
+    {
+        PathStats& ps = paths[path];
+        ps.visits++;
+        ps.nodes += node.nodes;
+    }
+
+    if (path.size() == maxLength)
+        return;
+
+    for (const Node& child : node.children)
+    {
+        path.push_back(child.move);
+        aggregate(child, path, maxLength, paths);
+        path.pop_back();
+    }
+  }
+
+} // namespace
+
+
+/// TreeDump::open() is called when the "Tree Dump File" option changes. It
+/// closes the current file, if any, and starts a new one unless the name is
+/// empty or "<empty>".
+
+void TreeDump::open(const std::string& fname) {
+
+  if (file.is_open())
+  {
+      flush();
+      file.close();
+  }
+
+  if (fname.empty() || fname == "<empty>")
+      return;
+
+  file.open(fname, std::ios::out | std::ios::binary | std::ios::trunc);
+
+  if (!file.is_open())
+  {
+      sync_cout << "info string Unable to open tree dump file " << fname << sync_endl;
+      return;
+  }
+
+  file.write(Magic, sizeof(Magic));
+  file.write(reinterpret_cast<const char*>(&Version), sizeof(Version));
+  file.write(reinterpret_cast<const char*>(&RecordSize), sizeof(RecordSize));
+  buffer.reserve(BufferSize);
+}
+
+
+/// TreeDump::depth() returns the highest ply to dump, or 0 when dumping is off
+
+int TreeDump::depth() {
+
+  return file.is_open() ? int(Options["Tree Dump Depth"]) : 0;
+}
+
+
+/// TreeDump::write() appends a record to the write buffer, flushing it to
+/// disk when full.
+
+void TreeDump::write(int ply, Move m, Value alpha, Value beta, Value v, uint64_t nodes) {
+
+  char rec[RecordSize] = {};
+  uint32_t move = uint32_t(m);
+  int16_t window[3] = { int16_t(alpha), int16_t(beta), int16_t(v) };
+
+  std::memcpy(rec, &nodes, 8);
+  std::memcpy(rec + 8, &move, 4);
+  std::memcpy(rec + 12, window, 6);
+  rec[18] = char(ply);
+
+  buffer.insert(buffer.end(), rec, rec + RecordSize);
+
+  if (buffer.size() >= BufferSize)
+      flush();
+}
+
+
+/// TreeDump::flush() writes out the buffered records, called at the end of
+/// each search so that the file can be read while the engine is running.
+
+void TreeDump::flush() {
+
+  if (file.is_open() && !buffer.empty())
+  {
+      file.write(buffer.data(), buffer.size());
+      file.flush();
+  }
+
+  buffer.clear();
+}
+
+
+/// TreeDump::view() is called by the 'treeview <file> [length] [top]' command.
+/// It rebuilds the trees stored in the file and prints, for each path length
+/// up to 'length', the 'top' move paths that consumed the most nodes summed
+/// over all the searches in the file.
+
+void TreeDump::view(std::istream& is) {
+
+  std::string fname, token;
+  size_t length = 2, top = 10;
+
+  is >> fname;
+
+  if (is >> token)
+      length = std::clamp(std::stoi(token), 1, 255);
+
+  if (is >> token)
+      top = std::max(std::stoi(token), 1);
+
+  std::ifstream in(fname, std::ios::in | std::ios::binary);
+  char magic[4];
+  uint32_t version = 0, recordSize = 0;
+
+  in.read(magic, sizeof(magic));
+  in.read(reinterpret_cast<char*>(&version), sizeof(version));
+  in.read(reinterpret_cast<char*>(&recordSize), sizeof(recordSize));
+
+  if (   !in
+      || std::memcmp(magic, Magic, sizeof(Magic))
+      || version != Version
+      || recordSize != RecordSize)
+  {
+      sync_cout << "Not a tree dump file: " << fname << sync_endl;
+      return;
+  }
+
+  // Records come in post-order, so the pending nodes at ply + 1 are exactly
+  // the children of the next record at ply. A ply dropping by more than one
+  // means that records are missing: the pending nodes deeper than ply + 1 have
+  // no parent, and are dropped rather than hung under an unrelated node.
+  std::vector<std::vector<Node>> pending(256);
+  char rec[RecordSize];
+  uint64_t records = 0, orphans = 0;
+  int lastPly = 0;
+
+  while (in.read(rec, RecordSize))
+  {
+      Node node;
+      uint32_t move;
+      int ply = uint8_t(rec[18]);
+
+      for (int p = ply + 2; p <= lastPly; ++p)
+          orphans += pending[p].size(), pending[p].clear();
+
+      lastPly = ply;
+
+      std::memcpy(&node.nodes, rec, 8);
+      std::memcpy(&move, rec + 8, 4);
+      node.move = Move(move);
+
+      if (ply + 1 < int(pending.size()))
+          node.children = std::move(pending[ply + 1]), pending[ply + 1].clear();
+
+      pending[ply].push_back(std::move(node));
+      records++;
+  }
+
+  std::map<std::vector<Move>, PathStats> paths;
+  std::vector<Move> path;
+  uint64_t total = 0;
+
+  for (const Node& root : pending[0])
+  {
+      total += root.nodes;
+      aggregate(root, path, length, paths);
+  }
+
+  std::stringstream ss;
+  ss << "Records: " << records << " searches: " << pending[0].size()
+     << " nodes: " << total << "\n" << std::fixed << std::setprecision(2);
+
+  if (orphans)
+      ss << "Warning: " << orphans << " subtrees without a parent were skipped\n";
+
+  for (size_t len = 1; len <= length; ++len)
+  {
+      std::vector<std::pair<std::vector<Move>, PathStats>> byNodes;
+
+      for (const auto& p : paths)
+          if (p.first.size() == len)
+              byNodes.push_back(p);
+
+      std::stable_sort(byNodes.begin(), byNodes.end(), [](const auto& a, const auto& b) {
+          return a.second.nodes > b.second.nodes;
+      });
+
+      ss << "\nPaths of length " << len << "\n";
+
+      for (size_t i = 0; i < std::min(top, byNodes.size()); ++i)
+      {
+          std::string moves;
+          for (Move m : byNodes[i].first)
+              moves += UCI::move(m) + " ";
+
+          ss << std::left << std::setw(6 * int(len) + 2) << moves << std::right
+             << std::setw(8)  << byNodes[i].second.visits
+             << std::setw(14) << byNodes[i].second.nodes
+             << std::setw(8)  << (total ? 100.0 * byNodes[i].second.nodes / total : 0.0) << "%\n";
+      }
+  }
+
+  sync_cout << ss.str() << sync_endl;
+}
+
+} // namespace Stockfish
@@ -0,0 +1,49 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2021 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TREEDUMP_H_INCLUDED
+#define TREEDUMP_H_INCLUDED
+
+#include <istream>
+#include <string>
+
+#include "types.h"
+
+namespace Stockfish {
+
+/// TreeDump streams the search tree, up to the ply set by the "Tree Dump Depth"
+/// option, to the file named by the "Tree Dump File" option. One fixed size
+/// record is written when a node returns (so children come before their parent)
+/// holding its ply, the move leading to it, the window it was searched with,
+/// the returned value and the number of nodes in its subtree, all from the
+/// point of view of the side to move at that node. The 'treeview' command reads
+/// such a file back and aggregates the node counts by move path.
+
+namespace TreeDump {
+
+void open(const std::string& fname);
+int depth();
+void write(int ply, Move m, Value alpha, Value beta, Value v, uint64_t nodes);
+void flush();
+void view(std::istream& is);
+
+} // namespace TreeDump
+
+} // namespace Stockfish
+
+#endif // #ifndef TREEDUMP_H_INCLUDED
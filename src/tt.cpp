@@ -0,0 +1,172 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2021 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstdlib>   // For exit()
+#include <cstring>   // For std::memset
+#include <iostream>
+
+#include "thread.h"
+#include "tt.h"
+
+namespace Stockfish {
+
+TranspositionTable TT; // Our global transposition table
+
+/// TTEntry::save() populates the TTEntry with a new node's data, possibly
+/// overwriting an old position. Update is not atomic and can be racy.
+
+void TTEntry::save(Key k, Value v, bool pv, Bound b, Depth d, Move m, Value ev) {
+
+  // Preserve any existing move for the same position
+  if (m || (uint16_t)k != key16)
+      move16 = (uint16_t)m;
+
+  // Overwrite less valuable entries (cheapest checks first)
+  if (   b == BOUND_EXACT
+      || (uint16_t)k != key16
+      || d - DEPTH_OFFSET > depth8 - 4)
+  {
+      assert(d > DEPTH_OFFSET);
+      assert(d < 256 + DEPTH_OFFSET);
+
+      key16     = (uint16_t)k;
+      depth8    = (uint8_t)(d - DEPTH_OFFSET);
+      genBound8 = (uint8_t)(TT.generation8 | uint8_t(pv) << 2 | b);
+      value16   = (int16_t)v;
+      eval16    = (int16_t)ev;
+  }
+}
+
+
+/// TranspositionTable::resize() sets the size of the transposition table,
+/// measured in megabytes. Transposition table consists of a power of 2 number
+/// of clusters and each cluster consists of ClusterSize number of TTEntry.
+
+void TranspositionTable::resize(size_t mbSize) {
+
+  Threads.main()->wait_for_search_finished();
+  Threads.wait_for_search_finished(); // The table may still be being cleared
+
+  aligned_large_pages_free(table);
+
+  clusterCount = mbSize * 1024 * 1024 / sizeof(Cluster);
+  partClusters = clusterCount / partCount;
+
+  table = static_cast<Cluster*>(aligned_large_pages_alloc(clusterCount * sizeof(Cluster)));
+  if (!table)
+  {
+      std::cerr << "Failed to allocate " << mbSize
+                << "MB for transposition table." << std::endl;
+      exit(EXIT_FAILURE);
+  }
+
+  // Shared by all the threads: spread it over the NUMA nodes before clear()
+  // first touches the pages.
+  numa_interleave(table, clusterCount * sizeof(Cluster));
+
+  clear();
+}
+
+
+/// TranspositionTable::clear() overwrites the entire transposition table
+/// with zeros. It is called whenever the table is resized, or when the
+/// user asks the program to clear the table (from the UCI interface). Every
+/// thread zeroes a slice of the table, and thus first touches it after a
+/// resize, in the background: the engine stays responsive with multi-GB
+/// tables and the next search waits for the clear to complete.
+
+void TranspositionTable::clear() {
+
+  const size_t n = Threads.size();
+
+  for (size_t idx = 0; idx < n; ++idx)
+      Threads[idx]->run_custom_job([this, idx, n]() {
+
+          const size_t stride = clusterCount / n,
+                       start  = stride * idx,
+                       len    = idx != n - 1 ? stride : clusterCount - start;
+
+          std::memset(static_cast<void*>(&table[start]), 0, len * sizeof(Cluster));
+      });
+
+  generation8 = 0;
+}
+
+
+/// TranspositionTable::partition() splits the table into 'n' equal parts,
+/// each probed by one thread only, so that no thread sees the entries of the
+/// others. Used by the deterministic parallel search, otherwise n is 1.
+
+void TranspositionTable::partition(size_t n) {
+
+  partCount = n;
+  partClusters = clusterCount / n;
+}
+
+
+/// TranspositionTable::probe() looks up the current position in the transposition
+/// table. It returns true and a pointer to the TTEntry if the position is found.
+/// Otherwise, it returns false and a pointer to an empty or least valuable TTEntry
+/// to be replaced later. The replace value of an entry is calculated as its depth
+/// minus 8 times its relative age. TTEntry t1 is considered more valuable than
+/// TTEntry t2 if its replace value is greater than that of t2. 'part' is the
+/// table partition to look in, see partition().
+
+TTEntry* TranspositionTable::probe(const Key key, bool& found, size_t part) const {
+
+  TTEntry* const tte = first_entry(key, part);
+  const uint16_t key16 = (uint16_t)key;  // Use the low 16 bits as key inside the cluster
+
+  for (int i = 0; i < ClusterSize; ++i)
+      if (tte[i].key16 == key16 || !tte[i].depth8)
+      {
+          tte[i].genBound8 = uint8_t(generation8 | (tte[i].genBound8 & (GENERATION_DELTA - 1))); // Refresh
+
+          return found = (bool)tte[i].depth8, &tte[i];
+      }
+
+  // Find an entry to be replaced according to the replacement strategy
+  TTEntry* replace = tte;
+  for (int i = 1; i < ClusterSize; ++i)
+      // Due to our packed storage format for generation and its cyclic
+      // nature we add GENERATION_CYCLE (256 is the modulus, plus what
+      // is needed to keep the unrelated lowest n bits from affecting
+      // the result) to calculate the entry age correctly even after
+      // generation8 overflows into the next cycle.
+      if (  replace->depth8 - ((GENERATION_CYCLE + generation8 - replace->genBound8) & GENERATION_MASK)
+          >   tte[i].depth8 - ((GENERATION_CYCLE + generation8 -   tte[i].genBound8) & GENERATION_MASK))
+          replace = &tte[i];
+
+  return found = false, replace;
+}
+
+
+/// TranspositionTable::hashfull() returns an approximation of the hashtable
+/// occupation during a search. The hash is x permill full, as per UCI protocol.
+
+int TranspositionTable::hashfull() const {
+
+  int cnt = 0;
+  for (int i = 0; i < 1000; ++i)
+      for (int j = 0; j < ClusterSize; ++j)
+          cnt += table[i].entry[j].depth8 && (table[i].entry[j].genBound8 & GENERATION_MASK) == generation8;
+
+  return cnt / ClusterSize;
+}
+
+} // namespace Stockfish
@@ -41,6 +41,7 @@
 #include <cstdint>
 #include <cstdlib>
 #include <algorithm>
+#include <array>
 
 #if defined(_MSC_VER)
 // Disable some silly and noisy warning from MSVC compiler
@@ -167,39 +168,18 @@ enum Piece {
   PIECE_NB = 16
 };
 
+enum Bound {
+  BOUND_NONE,
+  BOUND_UPPER,
+  BOUND_LOWER,
+  BOUND_EXACT = BOUND_UPPER | BOUND_LOWER
+};
+
 typedef int Depth;
 
-// zones of xiangqi board
-const int BOARD_ZONES[2][154] = {
-  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-  0, 1, 1, 1, 2, 2, 2, 1, 1, 1, 0,
-  0, 1, 1, 1, 2, 2, 2, 1, 1, 1, 0,
-  0, 1, 1, 1, 2, 2, 2, 1, 1, 1, 0,
-  0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0,
-  0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0,
-  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-
-  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-  0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0,
-  0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0,
-  0, 1, 1, 1, 2, 2, 2, 1, 1, 1, 0,
-  0, 1, 1, 1, 2, 2, 2, 1, 1, 1, 0,
-  0, 1, 1, 1, 2, 2, 2, 1, 1, 1, 0,
-  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+enum : int {
+  DEPTH_NONE          = -6,
+  DEPTH_OFFSET        = -7 // value used only for TT entry occupancy check
 };
 
 // directions
@@ -266,6 +246,36 @@ enum Square : int {
   SQUARE_NB   = 154
 };
 
+/// board_zone() returns 2 for the squares of the palace of side 'c', 1 for the
+/// other squares of its half of the board, up to the river, and 0 for the rest
+/// of the board and the squares off the board.
+
+constexpr int board_zone(Color c, int s) {
+
+  int f = s % 11, r = s / 11 - 2; // File and rank on the 9x10 board
+
+  if (f < 1 || f > 9 || r < 0 || r > 9)
+      return 0;
+
+  if (c == BLACK)
+      r = 9 - r;
+
+  return r > 4 ? 0 : r <= 2 && f >= 4 && f <= 6 ? 2 : 1;
+}
+
+// zones of xiangqi board, computed at compile time
+constexpr auto BOARD_ZONES = [] {
+  std::array<std::array<int, SQUARE_NB>, COLOR_NB> zones{};
+
+  for (int s = 0; s < SQUARE_NB; ++s)
+  {
+      zones[WHITE][s] = board_zone(WHITE, s);
+      zones[BLACK][s] = board_zone(BLACK, s);
+  }
+
+  return zones;
+}();
+
 // map type to piece
 const PieceType PIECE_TYPE[] = {
   NO_PIECE_TYPE, 
@@ -386,6 +396,18 @@ constexpr Piece move_source_piece(Move move) { return (Piece)((move >> 16) & 0xF
 constexpr Piece move_target_piece(Move move) { return (Piece)((move >> 20) & 0xF); }
 constexpr int move_capture_flag(Move move) { return (int)((move >> 24) & 0x1); }
 
+constexpr Color operator~(Color c) {
+  return Color(c ^ BLACK); // Toggle color
+}
+
+constexpr Value mate_in(int ply) {
+  return VALUE_MATE - ply;
+}
+
+constexpr Value mated_in(int ply) {
+  return -VALUE_MATE + ply;
+}
+
 /// Additional operators to add a Direction to a Square
 constexpr Square operator+(Square s, Direction d) { return Square(int(s) + int(d)); }
 constexpr Square operator-(Square s, Direction d) { return Square(int(s) - int(d)); }
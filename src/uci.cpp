@@ -18,21 +18,29 @@
 
 #include <cassert>
 #include <cmath>
+#include <iomanip>
 #include <iostream>
 #include <sstream>
 #include <string>
 
+#include "cluster.h"
+#include "dfpn.h"
 #include "evaluate.h"
 #include "movegen.h"
 #include "position.h"
 #include "search.h"
+#include "thread.h"
 #include "timeman.h"
+#include "treedump.h"
+#include "tt.h"
 #include "uci.h"
 
 using namespace std;
 
 namespace Stockfish {
 
+extern vector<string> setup_bench(istream&);
+
 namespace {
 
   // FEN string of the initial position, normal chess
@@ -107,7 +115,7 @@ namespace {
   void go(Position& pos, istringstream& is) {
     Search::LimitsType limits;
     string token;
-    //bool ponderMode = false;
+    bool ponderMode = false;
 
     limits.startTime = now(); // As early as possible!
 
@@ -127,9 +135,82 @@ namespace {
         else if (token == "mate")      is >> limits.mate;
         else if (token == "perft")     is >> limits.perft;
         else if (token == "infinite")  limits.infinite = 1;
-    
-    // start searching, output best move (or perft results)
-    Search::sync_search(pos, limits);
+        else if (token == "ponder")    ponderMode = true;
+
+    Threads.start_thinking(pos, limits, ponderMode);
+  }
+
+  // bench() is called when engine receives the "bench" command. Firstly
+  // a list of UCI commands is setup according to bench parameters, then
+  // it is run one by one printing a summary at the end.
+
+  void bench(Position& pos, istream& args, StateListPtr& states) {
+
+    string token, mode;
+    uint64_t num, nodes = 0, cnt = 1, modeNodes = 0;
+    PerfCounters perf;
+    TimePoint modeStart = 0;
+    stringstream modes; // Time to depth of every "SMP Mode", see setup_bench()
+    string smpMode = Options["SMP Mode"]; // Restored once the modes are compared
+
+    auto end_mode = [&]() {
+        if (!mode.empty())
+            modes << "\nSMP Mode " << left << setw(7) << mode << right
+                  << ": " << setw(8) << now() - modeStart << " ms "
+                  << setw(12) << modeNodes << " nodes";
+    };
+
+    vector<string> list = setup_bench(args);
+    num = count_if(list.begin(), list.end(), [](string s) { return s.find("go ") == 0 || s.find("eval") == 0; });
+
+    TimePoint elapsed = now();
+    perf.start();
+
+    for (const auto& cmd : list)
+    {
+        istringstream is(cmd);
+        is >> skipws >> token;
+
+        if (token == "go" || token == "eval")
+        {
+            cerr << "\nPosition: " << cnt++ << '/' << num << endl;
+            if (token == "go")
+            {
+               go(pos, is);
+               Threads.main()->wait_for_search_finished();
+               nodes += Threads.nodes_searched();
+               modeNodes += Threads.nodes_searched();
+            }
+            else
+               Eval::trace(pos);
+        }
+        else if (token == "setoption" && cmd.find("name SMP Mode value ") != string::npos)
+        {
+            end_mode();
+            mode = cmd.substr(cmd.rfind(' ') + 1);
+            modeStart = now();
+            modeNodes = 0;
+            setoption(is);
+        }
+        else if (token == "setoption")  setoption(is);
+        else if (token == "position")   position(pos, is, states);
+        else if (token == "ucinewgame") { pos.reset_repetitions(); Search::clear(); }
+    }
+
+    perf.stop();
+    end_mode();
+    Options["SMP Mode"] = smpMode;
+    elapsed = now() - elapsed + 1; // Ensure positivity to avoid a 'divide by zero'
+
+    dbg_print(); // Just before exiting
+
+    cerr << "\n==========================="
+         << "\nTotal time (ms) : " << elapsed
+         << "\nNodes searched  : " << nodes
+         << "\nNodes/second    : " << 1000 * nodes / elapsed
+         << modes.str() << endl;
+
+    perf.print("Bench counters", nodes);
   }
 
   // The win rate model returns the probability (per mille) of winning given an eval
@@ -181,32 +262,49 @@ void UCI::loop(int argc, char* argv[]) {
       token.clear(); // Avoid a stale if getline() returns empty or blank line
       is >> skipws >> token;
 
+      // Any command but 'isready' ends the speculative search on the likely
+      // replies, started after our last move.
+      if (!token.empty() && token != "isready")
+          Threads.stop_speculation();
+
       if (    token == "quit"
           ||  token == "stop")
-          {}//Threads.stop = true;
+      {
+          Threads.stop = true;
+          Cluster::stop();
+      }
 
       // The GUI sends 'ponderhit' to tell us the user has played the expected move.
       // So 'ponderhit' will be sent if we were told to ponder on the same move the
       // user has played. We should continue searching but switch from pondering to
-      // normal search.
-      //else if (token == "ponderhit")
-          //Threads.main()->ponder = false; // Switch to normal search
+      // normal search. The tree searched so far, and the hash table filled by it,
+      // are kept: the search simply goes on under the clock.
+      else if (token == "ponderhit")
+          Threads.main()->ponder = false; // Switch to normal search
 
       else if (token == "uci")
           sync_cout << "id name " << engine_info(true)
                     << "\n"       << Options
                     << "\nuciok"  << sync_endl;
 
-      else if (token == "setoption")  setoption(is);
+      else if (token == "setoption")  { setoption(is); Cluster::send(cmd); }
       else if (token == "go")         go(pos, is);
-      else if (token == "position")   position(pos, is, states);
-      else if (token == "ucinewgame") {pos.reset_repetitions(); Search::clear();}
-      else if (token == "isready")    std::cout << "readyok" << std::endl;
+      else if (token == "position")   { position(pos, is, states); Cluster::set_position(cmd); }
+      else if (token == "ucinewgame") { pos.reset_repetitions(); Search::clear(); Cluster::send(cmd); }
+      else if (token == "isready")    sync_cout << "readyok" << sync_endl;
 
       // Additional custom non-UCI commands, mainly for debugging.
       // Do not use these commands during a search!
+      else if (token == "bench")    bench(pos, is, states);
       else if (token == "d")        sync_cout << pos << sync_endl;
       else if (token == "eval")     Eval::trace(pos);
+      else if (token == "memory")   sync_cout << "info string " << large_pages_info() << sync_endl;
+      else if (token == "dfpn")     Dfpn::solve(pos, is);
+      else if (token == "worker")   { Cluster::serve(is); argc = 1; } // Serve the coordinator until it quits
+      else if (token == "stats")    { is >> token; Search::print_stats(token == "json"); }
+      else if (token == "treeview") TreeDump::view(is);
+      else if (token == "dbg")      { is >> token; token == "clear" ? dbg_clear() : dbg_print(); }
+      else if (token == "profile")  { is >> token; token == "clear" ? Tracing::clear() : Tracing::print(); }
       else if (!token.empty() && token[0] != '#')
           sync_cout << "Unknown command: " << cmd << sync_endl;
 
@@ -289,6 +387,9 @@ string UCI::move(Move m) {
   if (m == MOVE_NONE)
       return "(none)";
 
+  if (m == MOVE_NULL)
+      return "0000";
+
   string move = (string)COORDINATES[from] + (string)COORDINATES[to];
 
   return move;
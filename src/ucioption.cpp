@@ -18,12 +18,17 @@
 
 #include <algorithm>
 #include <cassert>
+#include <iostream>
 #include <ostream>
 #include <sstream>
 
+#include "cluster.h"
 #include "evaluate.h"
 #include "misc.h"
 #include "search.h"
+#include "thread.h"
+#include "treedump.h"
+#include "tt.h"
 #include "uci.h"
 
 using std::string;
@@ -36,9 +41,15 @@ namespace UCI {
 
 /// 'On change' actions, triggered by an option's value change
 void on_clear_hash(const Option&) { Search::clear(); }
-void on_hash_size(const Option& o) { if(o) {}/*TT.resize(size_t(o));*/ }
+void on_cluster_workers(const Option& o) { Cluster::connect(o); }
+void on_hash_size(const Option& o) { TT.resize(size_t(o)); }
+void on_lock_memory(const Option& o) {
+  if (!lock_large_pages(o))
+      sync_cout << "info string Unable to lock all the memory, see ulimit -l" << sync_endl;
+}
 void on_logger(const Option& o) { start_logger(o); }
-void on_threads(const Option& o) { if(o) {} /*Threads.set(size_t(o));*/ }
+void on_threads(const Option& o) { Threads.set(size_t(o)); }
+void on_tree_dump_file(const Option& o) { TreeDump::open(o); }
 void on_tb_path(const Option& o) { if (o) {}/*Tablebases::init(o);*/ }
 void on_use_NNUE(const Option& ) { /*Eval::NNUE::init();*/ }
 void on_eval_file(const Option& ) { /*Eval::NNUE::init();*/ }
@@ -63,7 +74,12 @@ void init(OptionsMap& o) {
   o["Threads"]               << Option(1, 1, 512, on_threads);
   o["Hash"]                  << Option(16, 1, MaxHashMB, on_hash_size);
   o["Clear Hash"]            << Option(on_clear_hash);
+  o["Lock Memory"]           << Option(false, on_lock_memory);
   o["Ponder"]                << Option(false);
+  o["Speculative Replies"]   << Option(0, 0, 64);
+  o["Deterministic SMP"]     << Option(false);
+  o["SMP Mode"]              << Option("Lazy var Lazy var ABDADA", "Lazy");
+  o["Cluster Workers"]       << Option("<empty>", on_cluster_workers);
   o["MultiPV"]               << Option(1, 1, 500);
   o["Skill Level"]           << Option(20, 0, 20);
   o["Move Overhead"]         << Option(10, 0, 5000);
@@ -78,6 +94,13 @@ void init(OptionsMap& o) {
   o["SyzygyProbeDepth"]      << Option(1, 1, 100);
   o["Syzygy50MoveRule"]      << Option(true);
   o["SyzygyProbeLimit"]      << Option(7, 0, 7);
+  o["Tree Dump File"]        << Option("<empty>", on_tree_dump_file);
+  o["Tree Dump Depth"]       << Option(3, 1, 64);
+  o["RFP Margin"]            << Option(50, 0, 1000);
+  o["Futility Base"]         << Option(60, 0, 1000);
+  o["Futility Margin"]       << Option(45, 0, 1000);
+  o["Razor Margin"]          << Option(150, 0, 1000);
+  o["LMP Base"]              << Option(3, 0, 100);
 }
 
 
@@ -10,7 +10,7 @@ trap 'error ${LINENO}' ERR
 
 echo "reprosearch testing started"
 
-# repeat two short games, separated by ucinewgame. 
+# repeat three short searches, separated by ucinewgame.
 # with go nodes $nodes they should result in exactly
 # the same node count for each iteration.
 cat << EOF > repeat.exp
@@ -26,7 +26,11 @@ cat << EOF > repeat.exp
  send "go nodes \$nodes\n"
  expect "bestmove"
 
- send "position startpos moves e2e4 e7e6\n"
+ send "position startpos moves h2e2 h7e7\n"
+ send "go nodes \$nodes\n"
+ expect "bestmove"
+
+ send "position fen rnbakab1r/9/1c4nc1/p1p1p1p1p/9/9/P1P1P1P1P/1C2C1N2/9/RNBAKAB1R b - - 0 1\n"
  send "go nodes \$nodes\n"
  expect "bestmove"
 
@@ -35,7 +39,11 @@ cat << EOF > repeat.exp
  send "go nodes \$nodes\n"
  expect "bestmove"
 
- send "position startpos moves e2e4 e7e6\n"
+ send "position startpos moves h2e2 h7e7\n"
+ send "go nodes \$nodes\n"
+ expect "bestmove"
+
+ send "position fen rnbakab1r/9/1c4nc1/p1p1p1p1p/9/9/P1P1P1P1P/1C2C1N2/9/RNBAKAB1R b - - 0 1\n"
  send "go nodes \$nodes\n"
  expect "bestmove"
 